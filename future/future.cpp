@@ -31,6 +31,8 @@
 
 #include "system_error.hpp"
 
+#include <algorithm>
+
 namespace ps
 {
     
@@ -60,6 +62,10 @@ namespace ps
                 return std::string("The state of the promise has already been set.");
             case future_errc::no_state:
                 return std::string("Operation not permitted on an object without an associated state.");
+            case future_errc::timeout:
+                return std::string("The deadline of the task passed before it could run.");
+            case future_errc::queue_full:
+                return std::string("The queue of the executor is full.");
         }
         return std::string("unspecified future_errc value\n");
     }
@@ -86,6 +92,53 @@ namespace ps
     {
     }
     
+    // wait_policy
+    
+    static std::atomic<std::uint32_t> wait_max_spin {wait_policy().max_spin};
+    static std::atomic<std::uint32_t> wait_max_yield {wait_policy().max_yield};
+    static std::atomic<bool> wait_adaptive {wait_policy().adaptive};
+    static std::atomic<std::uint32_t> wait_max_help_depth {wait_policy().max_help_depth};
+    // Spin iterations granted to the next adaptive wait.
+    static std::atomic<std::uint32_t> wait_spin_budget {256};
+    static constexpr std::uint32_t wait_min_spin = 16;
+    
+    void set_wait_policy(const wait_policy& policy) noexcept
+    {
+        wait_max_spin = policy.max_spin;
+        wait_max_yield = policy.max_yield;
+        wait_adaptive = policy.adaptive;
+        wait_max_help_depth = policy.max_help_depth;
+        wait_spin_budget = std::min(wait_spin_budget.load(), policy.max_spin);
+    }
+    
+    wait_policy get_wait_policy() noexcept
+    {
+        wait_policy policy;
+        policy.max_spin = wait_max_spin;
+        policy.max_yield = wait_max_yield;
+        policy.adaptive = wait_adaptive;
+        policy.max_help_depth = wait_max_help_depth;
+        return policy;
+    }
+    
+    // Moves the budget an eighth of the way towards target, so one outlier does not swing it.
+    static void update_spin_budget(std::uint32_t target, std::uint32_t max_spin)
+    {
+        auto budget = static_cast<std::int64_t>(wait_spin_budget.load(std::memory_order_relaxed));
+        auto goal = static_cast<std::int64_t>(std::min(std::max(target, wait_min_spin), max_spin));
+        wait_spin_budget.store(static_cast<std::uint32_t>(budget + (goal - budget) / 8), std::memory_order_relaxed);
+    }
+    
+    // Worker the calling thread belongs to, used to push nested tasks to the local deque and to help from waits.
+    static thread_local async_thread_worker* current_worker = nullptr;
+    // Waits of the calling thread currently running pool tasks.
+    static thread_local std::uint32_t help_depth = 0;
+    // A worker with nothing to help with parks on the state, for longer and longer as queueing a task wakes it anyway.
+    static constexpr std::chrono::milliseconds help_min_park {1};
+    static constexpr std::chrono::milliseconds help_max_park {64};
+    // Tasks of a preferred affinity key left to their busy worker before another worker is woken up to steal them.
+    static constexpr std::size_t preferred_backlog = 2;
+    
     // assoc_sub_state
     
     void assoc_sub_state::on_zero_shared() noexcept
@@ -93,35 +146,39 @@ namespace ps
         delete this;
     }
     
-    void assoc_sub_state::set_value()
+    void assoc_sub_state::set_satisfied()
     {
-        bool continuation = false;
+        if ((_status.fetch_or(satisfied) & satisfied) != 0)
         {
-            std::unique_lock<std::mutex> lk(_mut);
-            if (has_value())
-            {
-                throw future_error(make_error_code(future_errc::promise_already_satisfied));
-            }
-            _status |= constructed | ready;
-            _cv.notify_all();
-            if (has_continuation())
-            {
-                continuation = true;
-            }
+            throw future_error(make_error_code(future_errc::promise_already_satisfied));
+        }
+    }
+    
+    void assoc_sub_state::set_ready(std::uint32_t flags)
+    {
+        // Whoever comes second between set_ready and then_error runs the continuation, the wake syscall is skipped unless a waiter blocked on _status.
+        auto status = _status.fetch_or(flags);
+        if ((status & waiting) != 0)
+        {
+            atomic_notify_all(&_status);
         }
-        if (continuation)
+        if ((status & continuation_attached) != 0)
         {
-            ps::invoke(std::move(_continuation), _exception);
+            // Moved out so that the continuation and what it captured are gone once it ran.
+            auto continuation = std::move(_continuation);
+            continuation(_exception);
         }
     }
     
+    void assoc_sub_state::set_value()
+    {
+        set_satisfied();
+        set_ready(constructed | ready);
+    }
+    
     void assoc_sub_state::set_value_at_thread_exit()
     {
-        std::unique_lock<std::mutex> lk(_mut);
-        if (has_value())
-        {
-            throw future_error(make_error_code(future_errc::promise_already_satisfied));
-        }
+        set_satisfied();
         _status |= constructed;
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wundefined-func-template"
@@ -132,34 +189,14 @@ namespace ps
     
     void assoc_sub_state::set_exception(const std::exception_ptr& p)
     {
-        bool continuation = false;
-        {
-            std::unique_lock<std::mutex> lk(_mut);
-            if (has_value())
-            {
-                throw future_error(make_error_code(future_errc::promise_already_satisfied));
-            }
-            _exception = p;
-            _status |= ready;
-            _cv.notify_all();
-            if (has_continuation())
-            {
-                continuation = true;
-            }
-        }
-        if (continuation)
-        {
-            ps::invoke(std::move(_continuation), _exception);
-        }
+        set_satisfied();
+        _exception = p;
+        set_ready(ready);
     }
     
     void assoc_sub_state::set_exception_at_thread_exit(const std::exception_ptr& p)
     {
-        std::unique_lock<std::mutex> lk(_mut);
-        if (has_value())
-        {
-            throw future_error(make_error_code(future_errc::promise_already_satisfied));
-        }
+        set_satisfied();
         _exception = p;
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wundefined-func-template"
@@ -169,42 +206,27 @@ namespace ps
     
     void assoc_sub_state::then_error(fu2::unique_function<void(const std::exception_ptr&)>&& continuation)
     {
-        bool ready = false;
+        run_deferred();
+        if (!is_ready())
         {
-            std::unique_lock<std::mutex> lk(_mut);
-            _status |= continuation_attached;
-            if (is_ready())
-            {
-                ready = true;
-            }
-            else
+            _continuation = std::move(continuation);
+            if ((_status.fetch_or(continuation_attached) & ready) == 0)
             {
-                _continuation = std::move(continuation);
+                return;
             }
+            continuation = std::move(_continuation);
         }
-        if (ready)
-        {
-            ps::invoke(std::move(continuation), _exception);
-        }
+        ps::invoke(std::move(continuation), _exception);
     }
     
     void assoc_sub_state::make_ready()
     {
-        {
-            std::unique_lock<std::mutex> lk(_mut);
-            _status |= ready;
-        }
-        if (has_continuation())
-        {
-            ps::invoke(std::move(_continuation), _exception);
-        }
-        _cv.notify_all();
+        set_ready(ready);
     }
     
     void assoc_sub_state::copy()
     {
-        std::unique_lock<std::mutex> lk(_mut);
-        sub_wait(lk);
+        sub_wait();
         if (_exception != nullptr)
         {
             std::rethrow_exception(_exception);
@@ -213,27 +235,109 @@ namespace ps
     
     void assoc_sub_state::wait()
     {
-        std::unique_lock<std::mutex> lk(_mut);
-        sub_wait(lk);
+        sub_wait();
     }
     
-    void assoc_sub_state::sub_wait(std::unique_lock<std::mutex>& lk)
+    bool assoc_sub_state::spin_wait() const
     {
-        if (!is_ready())
+        // Spinning cannot help when the producer needs the only core.
+        static const bool multi_core = ps::thread::hardware_concurrency() > 1;
+        const std::uint32_t max_spin = multi_core ? wait_max_spin.load(std::memory_order_relaxed) : 0;
+        const bool adaptive = wait_adaptive.load(std::memory_order_relaxed);
+        const std::uint32_t budget = adaptive ? std::min(wait_spin_budget.load(std::memory_order_relaxed), max_spin) : max_spin;
+        for (std::uint32_t i = 0; i < budget; ++i)
+        {
+            if (is_ready())
+            {
+                if (adaptive)
+                {
+                    update_spin_budget(2 * i, max_spin);
+                }
+                return true;
+            }
+            this_thread::relax();
+        }
+        const std::uint32_t max_yield = wait_max_yield.load(std::memory_order_relaxed);
+        for (std::uint32_t i = 0; i < max_yield; ++i)
         {
-            if ((_status & deferred) == deferred)
+            if (is_ready())
             {
-                _status &= static_cast<std::uint8_t>(~deferred);
-                lk.unlock();
-                execute();
+                if (adaptive)
+                {
+                    update_spin_budget(2 * budget, max_spin);
+                }
+                return true;
             }
-            else
+            this_thread::yield();
+        }
+        if (adaptive)
+        {
+            update_spin_budget(wait_min_spin, max_spin);
+        }
+        return is_ready();
+    }
+    
+    // A deferred task runs on the first thread that waits on its state or attaches a continuation to it, clearing the
+    // flag elects that thread so the task never runs twice.
+    void assoc_sub_state::run_deferred()
+    {
+        if ((_status.load(std::memory_order_relaxed) & deferred) != 0 &&
+            (_status.fetch_and(static_cast<std::uint32_t>(~deferred)) & deferred) != 0)
+        {
+            execute();
+        }
+    }
+    
+    void assoc_sub_state::sub_wait()
+    {
+        if (is_ready())
+        {
+            return;
+        }
+        run_deferred();
+        if (is_ready())
+        {
+            return;
+        }
+        if (current_worker != nullptr && help_depth < wait_max_help_depth.load(std::memory_order_relaxed))
+        {
+            // Parking a worker while its pool has queued tasks wastes a core and deadlocks once every worker waits, so
+            // run those tasks instead. The park is bounded as new tasks may be pushed to this worker meanwhile.
+            ++help_depth;
+            bool spun = false;
+            std::chrono::nanoseconds park = help_min_park;
+            while (!is_ready())
             {
-                while (!is_ready())
+                if (current_worker->help())
                 {
-                    _cv.wait(lk);
+                    park = help_min_park;
+                    continue;
+                }
+                if (!spun)
+                {
+                    spun = true;
+                    spin_wait();
+                    continue;
+                }
+                std::uint32_t status = _status.fetch_or(waiting) | waiting;
+                if ((status & ready) == 0)
+                {
+                    current_worker->park_waiting(&_status, status, park);
+                    park = std::min<std::chrono::nanoseconds>(2 * park, help_max_park);
                 }
             }
+            --help_depth;
+            return;
+        }
+        if (spin_wait())
+        {
+            return;
+        }
+        std::uint32_t status = _status.fetch_or(waiting) | waiting;
+        while ((status & ready) == 0)
+        {
+            atomic_wait(&_status, status);
+            status = _status;
         }
     }
     
@@ -242,6 +346,23 @@ namespace ps
         throw future_error(make_error_code(future_errc::no_state));
     }
     
+    void assoc_sub_state::cancel(const std::exception_ptr& exception)
+    {
+        set_exception(exception);
+    }
+    
+    void assoc_sub_state::execute_until(std::chrono::steady_clock::time_point due)
+    {
+        if (due != std::chrono::steady_clock::time_point::max() && std::chrono::steady_clock::now() > due)
+        {
+            cancel(std::make_exception_ptr(future_error(make_error_code(future_errc::timeout))));
+        }
+        else
+        {
+            execute();
+        }
+    }
+    
     // future<void>
     
     future<void>::future(assoc_sub_state* state) : _state(state)
@@ -262,24 +383,45 @@ namespace ps
         }
     }
     
+    assoc_sub_state* future<void>::ensure_state()
+    {
+        if (_value.has_value())
+        {
+            std::unique_ptr<assoc_sub_state, release_shared_count> state {new assoc_sub_state()};
+            state->set_value();
+            state->set_future_attached();
+            _value.reset();
+            _state = state.release();
+        }
+        return _state;
+    }
+    
     void future<void>::get()
     {
+        if (_value.has_value())
+        {
+            _value.reset();
+            return;
+        }
         std::unique_ptr<shared_count, release_shared_count> __(_state);
         assoc_sub_state* s = _state;
         _state = nullptr;
         s->copy();
     }
     
-    void future<void>::then_error(fu2::unique_function<void(const std::exception_ptr&)>&& continuation)
+    void future<void>::on_ready(fu2::unique_function<void(const std::exception_ptr&)>&& continuation)
     {
+        if (_value.has_value())
+        {
+            ps::invoke(std::move(continuation), nullptr);
+            return;
+        }
         return _state->then_error(std::move(continuation));
     }
     
     future<void> make_ready_future()
     {
-        std::unique_ptr<assoc_sub_state, release_shared_count> state{new assoc_sub_state()};
-        state->set_value();
-        return future<void>(state.get());
+        return future<void>(std::in_place);
     }
     
     // promise<void>
@@ -355,11 +497,53 @@ namespace ps
         }
     }
     
-    void shared_future<void>::then_error(fu2::unique_function<void(const std::exception_ptr&)>&& continuation)
+    void shared_future<void>::on_ready(fu2::unique_function<void(const std::exception_ptr&)>&& continuation)
     {
         return _state->then_error(std::move(continuation));
     }
     
+    // mpsc_task_queue
+    
+    mpsc_task_queue::batch::~batch()
+    {
+        while (_first != nullptr)
+        {
+            delete std::exchange(_first, _first->next);
+        }
+    }
+    
+    executor_task mpsc_task_queue::batch::pop()
+    {
+        std::unique_ptr<node> first(_first);
+        _first = first->next;
+        return std::move(first->task);
+    }
+    
+    mpsc_task_queue::~mpsc_task_queue()
+    {
+        take_all();
+    }
+    
+    void mpsc_task_queue::push(executor_task&& task)
+    {
+        auto* n = new node{std::move(task), _head.load(std::memory_order_relaxed)};
+        while (!_head.compare_exchange_weak(n->next, n))
+        {
+        }
+    }
+    
+    mpsc_task_queue::batch mpsc_task_queue::take_all() noexcept
+    {
+        // The list is built newest first, reverse it so the batch pops in push order.
+        node* first = nullptr;
+        node* n = _head.exchange(nullptr);
+        while (n != nullptr)
+        {
+            first = std::exchange(n, std::exchange(n->next, first));
+        }
+        return batch(first);
+    }
+    
     // async_queued
     
     async_queued& get_async_queued()
@@ -368,7 +552,7 @@ namespace ps
         return queue;
     }
     
-    async_queued::async_queued() : _stop(false)
+    async_queued::async_queued()
     {
         start();
     }
@@ -380,18 +564,55 @@ namespace ps
     
     void async_queued::post(assoc_sub_state* state)
     {
-        std::lock_guard<std::mutex> lock(_mutex);
+        switch (_gate.admit(_pending, ps::this_thread::get_id() == _thread.get_id()))
+        {
+            case queue_gate::admission::run_inline:
+                state->execute();
+                return;
+            case queue_gate::admission::reject:
+                state->cancel(std::make_exception_ptr(future_error(make_error_code(future_errc::queue_full))));
+                return;
+            case queue_gate::admission::queue:
+                break;
+        }
         state->add_shared();
-        _tasks.push(state);
-        _cond.notify_all();
+        ++_pending;
+        _tasks.push([state]() {
+            state->execute();
+            state->release_shared();
+        });
+        if (_parked.load() != 0 && _parked.exchange(0) != 0)
+        {
+            atomic_notify_all(&_parked);
+        }
+    }
+    
+    void async_queued::execute(executor_task&& task)
+    {
+        switch (_gate.admit(_pending, ps::this_thread::get_id() == _thread.get_id()))
+        {
+            case queue_gate::admission::run_inline:
+                task();
+                return;
+            case queue_gate::admission::reject:
+                throw future_error(make_error_code(future_errc::queue_full));
+            case queue_gate::admission::queue:
+                break;
+        }
+        ++_pending;
+        _tasks.push(std::move(task));
+        if (_parked.load() != 0 && _parked.exchange(0) != 0)
+        {
+            atomic_notify_all(&_parked);
+        }
     }
     
     void async_queued::stop()
     {
+        _stop = true;
+        if (_parked.exchange(0) != 0)
         {
-            std::lock_guard<std::mutex> _lock(_mutex);
-            _stop = true;
-            _cond.notify_all();
+            atomic_notify_all(&_parked);
         }
         if (_thread.joinable())
         {
@@ -402,27 +623,30 @@ namespace ps
     void async_queued::start()
     {
         _thread = ps::thread([this] {
-            std::unique_lock<std::mutex> lock(_mutex);
             while (!_stop)
             {
+                auto tasks = _tasks.take_all();
+                if (tasks.empty())
+                {
+                    // Announce the park before the last look at the queue, a producer either sees the flag or its
+                    // task is seen here.
+                    _parked = 1;
+                    if (_tasks.empty() && !_stop)
+                    {
+                        atomic_wait(&_parked, 1);
+                    }
+                    _parked = 0;
+                    continue;
+                }
 #ifdef __APPLE__
                 @autoreleasepool {
 #endif
-                _cond.wait(lock, [this]() {
-                    return _stop || !_tasks.empty();
-                });
-                if (_stop)
-                {
-                    break;
-                }
-                while (!_tasks.empty())
+                while (!tasks.empty())
                 {
-                    auto state = _tasks.front();
-                    _tasks.pop();
-                    lock.unlock();
-                    state->execute();
-                    lock.lock();
-                    state->release_shared();
+                    auto task = tasks.pop();
+                    --_pending;
+                    _gate.release();
+                    task();
                 }
 #ifdef __APPLE__
                 }
@@ -431,144 +655,1078 @@ namespace ps
         });
     }
     
-    // async_thread_pool
-    
-    async_thread_pool& get_async_thread_pool()
-    {
-        static async_thread_pool queue;
-        return queue;
-    }
+    // queue_gate
     
-    async_thread_worker::async_thread_worker()
+    void queue_gate::set_bounds(const queue_bounds& bounds)
     {
-        _thread = ps::thread([this] {
-            std::unique_lock<std::mutex> lock(_m);
-            while (!_stop)
-            {
-#ifdef __APPLE__
-                @autoreleasepool {
-#endif
-                _start_cond.wait(lock, [this] {
-                    return _task != nullptr || _stop;
-                });
-                if (_stop)
-                    break;
-                lock.unlock();
-                _task->execute();
-                lock.lock();
-                _task->release_shared();
-                _task = nullptr;
-                _has_task = false;
-                ps::invoke(_completion_cb);
-#ifdef __APPLE__
-                }
-#endif
-            }
-        });
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _capacity = bounds.capacity;
+            _overflow = bounds.overflow;
+        }
+        // The new bounds may let blocked submitters through.
+        _cond.notify_all();
     }
     
-    async_thread_worker::~async_thread_worker()
+    queue_bounds queue_gate::bounds() const noexcept
     {
-        stop();
+        queue_bounds bounds;
+        bounds.capacity = _capacity;
+        bounds.overflow = _overflow;
+        return bounds;
     }
     
-    void async_thread_worker::stop()
+    queue_gate::admission queue_gate::overflow(const std::atomic<std::size_t>& pending, bool consumer)
     {
+        switch (_overflow.load())
         {
-            std::lock_guard<std::mutex> lock(_m);
-            _stop = true;
-            _start_cond.notify_all();
+            case overflow_policy::reject:
+                return admission::reject;
+            case overflow_policy::run_inline:
+                return admission::run_inline;
+            case overflow_policy::block:
+                break;
         }
-        if (_thread.joinable())
+        if (consumer)
         {
-            _thread.join();
+            return admission::run_inline;
         }
+        std::unique_lock<std::mutex> lock(_mutex);
+        // Counted before looking at pending again, a consumer taking a task either sees the waiter or is seen here.
+        ++_waiting;
+        _cond.wait(lock, [this, &pending]() {
+            return _capacity == 0 || pending < _capacity || _overflow != overflow_policy::block;
+        });
+        --_waiting;
+        if (_capacity == 0 || pending < _capacity)
+        {
+            return admission::queue;
+        }
+        lock.unlock();
+        return overflow(pending, consumer);
     }
     
-    void async_thread_worker::post(assoc_sub_state* task, fu2::unique_function<void()>&& completion_cb)
+    void queue_gate::wake()
     {
-        std::unique_lock<std::mutex> lock(_m);
-        if (_task != nullptr)
         {
-            throw std::logic_error("Worker already has a pending task");
+            std::lock_guard<std::mutex> lock(_mutex);
         }
-        start_task(task, std::move(completion_cb));
+        _cond.notify_all();
     }
     
-    void async_thread_worker::start_task(assoc_sub_state* task, fu2::unique_function<void()>&& completion_cb)
+    // async_thread_cache
+    
+    async_thread_cache& get_async_thread_cache()
     {
-        _has_task = true;
-        _task = task;
-        _completion_cb = std::move(completion_cb);
-        _start_cond.notify_one();
+        // Leaked on purpose, detached threads may still be finishing a task while the program exits.
+        static async_thread_cache* cache = new async_thread_cache;
+        return *cache;
     }
     
-    async_thread_pool::async_thread_pool() : _tp(ps::thread::hardware_concurrency())
-    , _available_count(ps::thread::hardware_concurrency())
+    // Parking slot of a thread waiting for its next task, lives on that thread's stack.
+    class __attribute__((__visibility__("hidden"))) async_thread_cache::idle_thread
     {
-        _manager_thread = ps::thread([this] {
-            std::unique_lock<std::mutex> lock(_mutex);
-            while (!_stop)
-            {
-#ifdef __APPLE__
-                @autoreleasepool {
-#endif
-                _cond.wait(lock, [this] {
-                    return _stop || (!_task_queue.empty() && _available_count > 0);
-                });
-                while (!_task_queue.empty() && _available_count > 0)
-                {
-                    if (_stop)
-                    {
-                        break;
-                    }
-                    auto ready_it = std::find_if(_tp.begin(), _tp.end(), [](const async_thread_worker& worker) {
-                        return worker.available();
-                    });
-                    if (ready_it == _tp.end())
-                    {
-                        break;
-                    }
-                    auto task = _task_queue.front();
-                    _task_queue.pop();
-                    --_available_count;
-                    ready_it->post(task, [this] {
-                        ++_available_count;
-                        _cond.notify_one();
-                    });
-                }
-#ifdef __APPLE__
-                }
-#endif
-            }
+    public:
+        std::condition_variable cond;
+        executor_task task;
+    };
+    
+    async_thread_cache::async_thread_cache(std::chrono::nanoseconds idle_timeout, std::size_t max_idle) : _idle_timeout(idle_timeout), _max_idle(max_idle)
+    {
+    }
+    
+    async_thread_cache::~async_thread_cache()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _stop = true;
+        for (auto* idle : _idle)
+        {
+            idle->cond.notify_one();
+        }
+        _idle.clear();
+        _cond.wait(lock, [this]() {
+            return _thread_count == 0;
         });
     }
     
-    async_thread_pool::~async_thread_pool()
+    void async_thread_cache::execute(executor_task&& task)
     {
         {
             std::lock_guard<std::mutex> lock(_mutex);
-            _stop = true;
-            _cond.notify_all();
+            if (!_idle.empty())
+            {
+                auto* idle = _idle.back();
+                _idle.pop_back();
+                idle->task = std::move(task);
+                idle->cond.notify_one();
+                return;
+            }
+            ++_thread_count;
         }
-        if (_manager_thread.joinable())
+        try
         {
-            _manager_thread.join();
+            ps::thread(&async_thread_cache::run, this, std::move(task)).detach();
         }
-        for (auto& worker : _tp)
+        catch (...)
         {
-            worker.stop();
+            std::lock_guard<std::mutex> lock(_mutex);
+            --_thread_count;
+            _cond.notify_all();
+            throw;
         }
     }
     
-    void async_thread_pool::post(assoc_sub_state* task)
+    void async_thread_cache::set_idle_timeout(std::chrono::nanoseconds idle_timeout)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _idle_timeout = idle_timeout;
+    }
+    
+    std::chrono::nanoseconds async_thread_cache::idle_timeout()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _idle_timeout;
+    }
+    
+    void async_thread_cache::set_max_idle(std::size_t max_idle)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _max_idle = max_idle;
+        while (_idle.size() > _max_idle)
+        {
+            _idle.front()->cond.notify_one();
+            _idle.erase(_idle.begin());
+        }
+    }
+    
+    std::size_t async_thread_cache::max_idle()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _max_idle;
+    }
+    
+    std::size_t async_thread_cache::size()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _thread_count;
+    }
+    
+    std::size_t async_thread_cache::idle()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _idle.size();
+    }
+    
+    void async_thread_cache::run(executor_task&& task)
     {
+        idle_thread slot;
+        std::unique_lock<std::mutex> lock(_mutex, std::defer_lock);
+        while (true)
         {
-            std::unique_lock<std::mutex> lock(_mutex);
-            _task_queue.push(task);
-            task->add_shared();
+#ifdef __APPLE__
+            @autoreleasepool {
+#endif
+            task();
+            task = nullptr;
+#ifdef __APPLE__
+            }
+#endif
+            // The task is over for its caller, so what it registered to happen at thread exit happens now.
+            thread_local_data()->run_at_thread_exit();
+            
+            lock.lock();
+            if (_stop || _idle.size() >= _max_idle)
+            {
+                break;
+            }
+            _idle.push_back(&slot);
+            slot.cond.wait_for(lock, _idle_timeout, [this, &slot]() {
+                return slot.task || std::find(_idle.begin(), _idle.end(), &slot) == _idle.end();
+            });
+            if (!slot.task)
+            {
+                auto it = std::find(_idle.begin(), _idle.end(), &slot);
+                if (it != _idle.end())
+                {
+                    _idle.erase(it);
+                }
+                break;
+            }
+            task = std::move(slot.task);
+            lock.unlock();
+        }
+        --_thread_count;
+        _cond.notify_all();
+    }
+    
+    // async_thread_pool
+    
+    async_thread_pool& get_async_thread_pool()
+    {
+        static async_thread_pool queue;
+        return queue;
+    }
+    
+    async_thread_worker::async_thread_worker(async_thread_pool* pool, std::size_t index) : _pool(pool), _index(index), _seed(static_cast<std::uint32_t>(index) + 1)
+    {
+    }
+    
+    async_thread_worker::~async_thread_worker()
+    {
+        join();
+    }
+    
+    void async_thread_worker::start()
+    {
+        _thread = ps::thread([this] {
+            run();
+        });
+    }
+    
+    void async_thread_worker::join()
+    {
+        if (_thread.joinable())
+        {
+            _thread.join();
+        }
+    }
+    
+    std::chrono::steady_clock::time_point async_thread_worker::push(executor_task&& task, std::chrono::steady_clock::time_point queued, priority lane)
+    {
+        const auto index = static_cast<std::size_t>(lane);
+        std::lock_guard<std::mutex> lock(_m);
+        auto& tasks = current_worker == this ? _tasks[index] : _inbox[index];
+        tasks.push_back(queued_task{std::move(task), queued, {}});
+        ++_pool->_lane_pending[index];
+        ++_pool->_pending;
+        return oldest(index, queued);
+    }
+    
+    std::chrono::steady_clock::time_point async_thread_worker::push_bulk(std::vector<executor_task>::iterator first, std::vector<executor_task>::iterator last, std::chrono::steady_clock::time_point queued, priority lane)
+    {
+        const auto index = static_cast<std::size_t>(lane);
+        const auto count = static_cast<std::size_t>(std::distance(first, last));
+        std::lock_guard<std::mutex> lock(_m);
+        auto& tasks = current_worker == this ? _tasks[index] : _inbox[index];
+        for (auto it = first; it != last; ++it)
+        {
+            tasks.push_back(queued_task{std::move(*it), queued, {}});
+        }
+        _pool->_lane_pending[index] += count;
+        _pool->_pending += count;
+        return oldest(index, queued);
+    }
+    
+    std::chrono::steady_clock::time_point async_thread_worker::oldest(std::size_t lane, std::chrono::steady_clock::time_point queued) const
+    {
+        if (!_tasks[lane].empty())
+        {
+            queued = std::min(queued, _tasks[lane].front().queued);
+        }
+        if (!_inbox[lane].empty())
+        {
+            queued = std::min(queued, _inbox[lane].front().queued);
+        }
+        return queued;
+    }
+    
+    std::size_t async_thread_worker::backlog(std::size_t lane)
+    {
+        std::lock_guard<std::mutex> lock(_m);
+        return _tasks[lane].size() + _inbox[lane].size();
+    }
+    
+    void async_thread_worker::push_pinned(executor_task&& task, std::chrono::steady_clock::time_point queued, priority lane)
+    {
+        std::lock_guard<std::mutex> lock(_m);
+        _pinned[static_cast<std::size_t>(lane)].push_back(queued_task{std::move(task), queued, {}});
+        // _pending moves first and back last, so that _pending - _pinned never shows fewer stealable tasks than there are.
+        ++_pool->_pending;
+        ++_pool->_pinned;
+        ++_pinned_count;
+    }
+    
+    async_thread_worker::queued_task async_thread_worker::pop_pinned(std::size_t lane)
+    {
+        std::lock_guard<std::mutex> lock(_m);
+        auto& tasks = _pinned[lane];
+        if (tasks.empty())
+        {
+            return queued_task();
+        }
+        auto task = std::move(tasks.front());
+        tasks.pop_front();
+        --_pinned_count;
+        --_pool->_pinned;
+        --_pool->_pending;
+        return task;
+    }
+    
+    bool async_thread_worker::help()
+    {
+        auto task = _pool->take(*this, false);
+        if (!task)
+        {
+            return false;
+        }
+        task();
+        return true;
+    }
+    
+    void async_thread_worker::park_waiting(const std::atomic<std::uint32_t>* status, std::uint32_t old, std::chrono::nanoseconds timeout)
+    {
+        // Either the pool sees _waiting_on after queueing a task or this sees the task. A wake up landing right before
+        // the wait is lost, the timeout bounds how late the task is picked up then.
+        _waiting_on = status;
+        ++_pool->_waiting;
+        if (!_pool->has_stealable())
+        {
+            atomic_wait_for(status, old, timeout);
+        }
+        --_pool->_waiting;
+        _waiting_on = nullptr;
+    }
+    
+    async_thread_worker::queued_task async_thread_worker::pop(std::size_t lane)
+    {
+        std::lock_guard<std::mutex> lock(_m);
+        auto& tasks = _tasks[lane].empty() ? _inbox[lane] : _tasks[lane];
+        if (tasks.empty())
+        {
+            return queued_task();
+        }
+        queued_task task;
+        if (_pool->_policy == queue_policy::fifo || &tasks == &_inbox[lane])
+        {
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        else
+        {
+            task = std::move(tasks.back());
+            tasks.pop_back();
+        }
+        --_pool->_lane_pending[lane];
+        --_pool->_pending;
+        return task;
+    }
+    
+    async_thread_worker::queued_task async_thread_worker::steal(std::size_t lane)
+    {
+        std::lock_guard<std::mutex> lock(_m);
+        auto& tasks = _inbox[lane].empty() ? _tasks[lane] : _inbox[lane];
+        if (tasks.empty())
+        {
+            return queued_task();
+        }
+        auto task = std::move(tasks.front());
+        tasks.pop_front();
+        --_pool->_lane_pending[lane];
+        --_pool->_pending;
+        return task;
+    }
+    
+    std::size_t async_thread_worker::next_victim(std::size_t count)
+    {
+        // xorshift32, only used to spread thieves over the other deques
+        _seed ^= _seed << 13;
+        _seed ^= _seed >> 17;
+        _seed ^= _seed << 5;
+        return _seed % count;
+    }
+    
+    void async_thread_worker::run()
+    {
+        current_worker = this;
+        if (!_pool->_name.empty())
+        {
+            ps::this_thread::set_name((_pool->_name + "." + std::to_string(_index)).c_str());
+        }
+        while (!_pool->retire_excess(*this))
+        {
+#ifdef __APPLE__
+            @autoreleasepool {
+#endif
+            auto task = _pool->take(*this, true);
+            if (!task)
+            {
+                if (!_pool->park(*this))
+                {
+                    break;
+                }
+                continue;
+            }
+            --_pool->_available_count;
+            task();
+            task = nullptr;
+            ++_pool->_available_count;
+#ifdef __APPLE__
+            }
+#endif
+        }
+        current_worker = nullptr;
+    }
+    
+    async_thread_pool::async_thread_pool() : async_thread_pool(0)
+    {
+    }
+    
+    // Heap order of the deadline queues, the earliest deadline ends up on top.
+    static bool later_deadline(const async_thread_worker::queued_task& a, const async_thread_worker::queued_task& b)
+    {
+        return a.due > b.due;
+    }
+    
+    static std::size_t hardware_workers()
+    {
+        return std::max(ps::thread::hardware_concurrency(), 1u);
+    }
+    
+    static pool_sizing fixed_sizing(std::size_t worker_count)
+    {
+        pool_sizing sizing;
+        sizing.min_workers = worker_count > 0 ? worker_count : hardware_workers();
+        sizing.max_workers = sizing.min_workers;
+        return sizing;
+    }
+    
+    async_thread_pool::async_thread_pool(std::size_t worker_count, std::string name, queue_policy policy) : async_thread_pool(fixed_sizing(worker_count), std::move(name), policy)
+    {
+    }
+    
+    async_thread_pool::async_thread_pool(const pool_sizing& sizing, std::string name, queue_policy policy) : _name(std::move(name)), _policy(policy), _sizing(sizing)
+    {
+        if (_sizing.max_workers == 0)
+        {
+            _sizing.max_workers = hardware_workers();
+        }
+        _sizing.min_workers = std::min(std::max(_sizing.min_workers, std::size_t(1)), _sizing.max_workers);
+        if (_sizing.max_blocking_workers == 0)
+        {
+            _sizing.max_blocking_workers = _sizing.max_workers;
+        }
+        const auto slots = _sizing.max_workers + _sizing.max_blocking_workers;
+        _tp.reserve(slots);
+        for (std::size_t i = 0; i < slots; ++i)
+        {
+            _tp.emplace_back(std::make_unique<async_thread_worker>(this, i));
+        }
+        _size = _sizing.min_workers;
+        _started = _sizing.min_workers;
+        _available_count = _sizing.min_workers;
+        for (std::size_t i = 0; i < _sizing.min_workers; ++i)
+        {
+            _tp[i]->start();
+        }
+    }
+    
+    async_thread_pool::~async_thread_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        wake_all();
+        for (auto& worker : _tp)
+        {
+            worker->join();
+        }
+    }
+    
+    void async_thread_pool::post(assoc_sub_state* task)
+    {
+        post(task, task_options(task->get_priority()));
+    }
+    
+    void async_thread_pool::post(assoc_sub_state* task, const task_options& options)
+    {
+        switch (admit())
+        {
+            case queue_gate::admission::run_inline:
+                task->execute_until(options.due);
+                return;
+            case queue_gate::admission::reject:
+                task->cancel(std::make_exception_ptr(future_error(make_error_code(future_errc::queue_full))));
+                return;
+            case queue_gate::admission::queue:
+                break;
+        }
+        task->add_shared();
+        enqueue([task, due = options.due]() {
+            task->execute_until(due);
+            task->release_shared();
+        }, options);
+    }
+    
+    void async_thread_pool::execute(executor_task&& task)
+    {
+        execute(std::move(task), task_options());
+    }
+    
+    void async_thread_pool::execute(executor_task&& task, const task_options& options)
+    {
+        switch (admit())
+        {
+            case queue_gate::admission::run_inline:
+                task();
+                return;
+            case queue_gate::admission::reject:
+                throw future_error(make_error_code(future_errc::queue_full));
+            case queue_gate::admission::queue:
+                break;
+        }
+        enqueue(std::move(task), options);
+    }
+    
+    bool async_thread_pool::on_worker() const noexcept
+    {
+        return current_worker != nullptr && current_worker->_pool == this;
+    }
+    
+    queue_gate::admission async_thread_pool::admit()
+    {
+        return _gate.admit(_pending, on_worker());
+    }
+    
+    void async_thread_pool::wake(async_thread_worker& worker)
+    {
+        // The worker sets _parked before its last look at its queues, it either sees the task or is seen here.
+        if (worker._parked)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            worker._parked = false;
+            worker._wake.notify_one();
+        }
+    }
+    
+    void async_thread_pool::wake_all()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        const std::size_t started = _started;
+        for (std::size_t i = 0; i < started; ++i)
+        {
+            _tp[i]->_parked = false;
+            _tp[i]->_wake.notify_one();
+        }
+    }
+    
+    void async_thread_pool::enqueue(executor_task&& task, const task_options& options)
+    {
+        if (options.has_deadline())
+        {
+            const auto index = static_cast<std::size_t>(options.lane);
+            const auto queued = queued_now();
+            auto oldest = queued;
+            {
+                std::lock_guard<std::mutex> lock(_deadline_mutex);
+                auto& heap = _deadlines[index];
+                heap.push_back(async_thread_worker::queued_task{std::move(task), queued, options.due});
+                std::push_heap(heap.begin(), heap.end(), later_deadline);
+                ++_deadline_pending[index];
+                ++_lane_pending[index];
+                ++_pending;
+                if (elastic())
+                {
+                    _deadline_queued[index].insert(queued);
+                    oldest = *_deadline_queued[index].begin();
+                }
+            }
+            notify(1);
+            grow(oldest);
+            return;
+        }
+        if (options.placement != affinity::none)
+        {
+            auto& owner = *_tp[options.key % _sizing.min_workers];
+            if (options.placement == affinity::pinned)
+            {
+                owner.push_pinned(std::move(task), queued_now(), options.lane);
+                wake(owner);
+                return;
+            }
+            const auto oldest = owner.push(std::move(task), queued_now(), options.lane);
+            // The owner gets the first chance, the other workers are only woken up once it is falling behind.
+            if (owner._parked)
+            {
+                wake(owner);
+            }
+            else if (owner.backlog(static_cast<std::size_t>(options.lane)) > preferred_backlog)
+            {
+                notify(1);
+            }
+            else if (auto status = owner._waiting_on.load())
+            {
+                // The state may be gone already, the wake up only hashes the address.
+                atomic_notify_all(status);
+            }
+            grow(oldest);
+            return;
+        }
+        auto worker = current_worker;
+        if (worker == nullptr || worker->_pool != this)
+        {
+            worker = _tp[_next++ % _size].get();
+        }
+        const auto oldest = worker->push(std::move(task), queued_now(), options.lane);
+        notify(1);
+        grow(oldest);
+    }
+    
+    void async_thread_pool::execute_bulk(std::vector<executor_task>&& tasks)
+    {
+        execute_bulk(std::move(tasks), task_options());
+    }
+    
+    void async_thread_pool::execute_bulk(std::vector<executor_task>&& tasks, const task_options& options)
+    {
+        switch (admit())
+        {
+            case queue_gate::admission::run_inline:
+                for (auto& task : tasks)
+                {
+                    task();
+                }
+                tasks.clear();
+                return;
+            case queue_gate::admission::reject:
+                throw future_error(make_error_code(future_errc::queue_full));
+            case queue_gate::admission::queue:
+                break;
+        }
+        enqueue_bulk(std::move(tasks), options.lane);
+    }
+    
+    void async_thread_pool::enqueue_bulk(std::vector<executor_task>&& tasks, priority lane)
+    {
+        const auto count = tasks.size();
+        if (count == 0)
+        {
+            return;
+        }
+        const auto queued = queued_now();
+        auto oldest = queued;
+        auto worker = current_worker;
+        if (worker != nullptr && worker->_pool == this)
+        {
+            // Idle workers steal from here, which keeps nested fan-outs close to their parent.
+            oldest = worker->push_bulk(tasks.begin(), tasks.end(), queued, lane);
+        }
+        else
+        {
+            const std::size_t workers = _size;
+            const auto start = _next++;
+            std::size_t begin = 0;
+            for (std::size_t i = 0; i < workers && begin < count; ++i)
+            {
+                const auto end = begin + (count - begin + workers - i - 1) / (workers - i);
+                oldest = std::min(oldest, _tp[(start + i) % workers]->push_bulk(tasks.begin() + static_cast<std::ptrdiff_t>(begin), tasks.begin() + static_cast<std::ptrdiff_t>(end), queued, lane));
+                begin = end;
+            }
+        }
+        tasks.clear();
+        notify(count);
+        grow(oldest);
+    }
+    
+    executor_task async_thread_pool::take(async_thread_worker& worker, bool pinned)
+    {
+        // A lane is only looked at once the higher ones are empty everywhere, including the other workers' deques.
+        async_thread_worker::queued_task entry;
+        for (std::size_t lane = 0; lane < priority_count && !entry.task; ++lane)
+        {
+            if (pinned && worker._pinned_count > 0)
+            {
+                entry = worker.pop_pinned(lane);
+                if (entry.task)
+                {
+                    // Another worker would not help with it, no point in growing the pool.
+                    _gate.release();
+                    return std::move(entry.task);
+                }
+            }
+            if (_lane_pending[lane] == 0)
+            {
+                continue;
+            }
+            if (_deadline_pending[lane] > 0)
+            {
+                entry = take_deadline(lane);
+                if (entry.task)
+                {
+                    break;
+                }
+            }
+            entry = worker.pop(lane);
+            if (entry.task)
+            {
+                break;
+            }
+            const std::size_t count = _started;
+            const auto first = worker.next_victim(count);
+            for (std::size_t i = 0; i < count && _lane_pending[lane] > 0 && !entry.task; ++i)
+            {
+                auto& victim = _tp[(first + i) % count];
+                if (victim.get() != &worker)
+                {
+                    entry = victim->steal(lane);
+                }
+            }
+        }
+        if (entry.task)
+        {
+            _gate.release();
+            grow(entry.queued);
+        }
+        return std::move(entry.task);
+    }
+    
+    async_thread_worker::queued_task async_thread_pool::take_deadline(std::size_t lane)
+    {
+        std::lock_guard<std::mutex> lock(_deadline_mutex);
+        auto& heap = _deadlines[lane];
+        if (heap.empty())
+        {
+            return async_thread_worker::queued_task();
+        }
+        std::pop_heap(heap.begin(), heap.end(), later_deadline);
+        auto task = std::move(heap.back());
+        heap.pop_back();
+        if (elastic())
+        {
+            _deadline_queued[lane].erase(_deadline_queued[lane].find(task.queued));
+        }
+        --_deadline_pending[lane];
+        --_lane_pending[lane];
+        --_pending;
+        return task;
+    }
+    
+    bool async_thread_pool::park(async_thread_worker& worker)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        ++_sleeping;
+        // Pinned tasks of the other workers are not worth waking up for.
+        auto has_work = [this, &worker] {
+            return has_stealable() || worker._pinned_count > 0;
+        };
+        auto woken = [this, &worker, &has_work] {
+            return _stop || has_work() || (worker._index + 1 == _size && _size > capacity());
+        };
+        // _parked is set before every look at the queues, and again after a wake up cleared it.
+        worker._parked = true;
+        while (!woken())
+        {
+            if (!elastic())
+            {
+                worker._wake.wait(lock);
+            }
+            else if (worker._wake.wait_for(lock, _sizing.idle_timeout) == std::cv_status::timeout && !woken() && retire(worker, _sizing.min_workers))
+            {
+                worker._parked = false;
+                --_sleeping;
+                return false;
+            }
+            worker._parked = true;
+        }
+        worker._parked = false;
+        --_sleeping;
+        return has_work() || !_stop;
+    }
+    
+    bool async_thread_pool::has_stealable() const noexcept
+    {
+        // _pinned is read first so that a concurrent push or pop can only overestimate what is left to steal.
+        const std::size_t pinned = _pinned;
+        return _pending > pinned;
+    }
+    
+    void async_thread_pool::notify(std::size_t count)
+    {
+        if (_waiting > 0)
+        {
+            const std::size_t started = _started;
+            for (std::size_t i = 0; i < started; ++i)
+            {
+                // The state may be gone already, the wake up only hashes the address.
+                if (auto status = _tp[i]->_waiting_on.load())
+                {
+                    atomic_notify_all(status);
+                }
+            }
+        }
+        // _pending was incremented before reading _sleeping, a worker going to sleep either sees the new task or is counted here.
+        if (_sleeping > 0)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            const std::size_t started = _started;
+            for (std::size_t i = 0; i < started && count > 0; ++i)
+            {
+                auto& worker = *_tp[i];
+                if (worker._parked)
+                {
+                    worker._parked = false;
+                    worker._wake.notify_one();
+                    --count;
+                }
+            }
+        }
+    }
+    
+    std::chrono::steady_clock::time_point async_thread_pool::queued_now() const
+    {
+        return elastic() ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+    }
+    
+    std::size_t async_thread_pool::capacity() const noexcept
+    {
+        return _sizing.max_workers + std::min<std::size_t>(_blocked, _sizing.max_blocking_workers);
+    }
+    
+    void async_thread_pool::grow(std::chrono::steady_clock::time_point queued)
+    {
+        if (_sleeping > 0 || _size >= capacity())
+        {
+            return;
+        }
+        // Above max_workers the pool is short of a blocked worker and its replacement is due straight away.
+        if (_size < _sizing.max_workers)
+        {
+            const auto now = std::chrono::steady_clock::now();
+            if (now - queued < _sizing.spawn_latency)
+            {
+                return;
+            }
+            // At most one new worker per spawn latency, the previous one may not have had the time to drain the queues.
+            auto last = _last_grow.load();
+            if (now.time_since_epoch().count() - last < std::chrono::duration_cast<std::chrono::steady_clock::duration>(_sizing.spawn_latency).count() || !_last_grow.compare_exchange_strong(last, now.time_since_epoch().count()))
+            {
+                return;
+            }
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        start_worker();
+    }
+    
+    bool async_thread_pool::start_worker()
+    {
+        const std::size_t index = _size;
+        if (_stop || index >= capacity())
+        {
+            return false;
+        }
+        auto& worker = _tp[index];
+        // The slot may belong to a retired worker that is still on its way out.
+        worker->join();
+        worker->start();
+        _started = std::max<std::size_t>(_started, index + 1);
+        ++_available_count;
+        ++_size;
+        return true;
+    }
+    
+    bool async_thread_pool::retire(async_thread_worker& worker, std::size_t target)
+    {
+        // Only the last running worker retires so that the running ones stay the first _size slots.
+        if (worker._index + 1 != _size || _size <= target)
+        {
+            return false;
+        }
+        --_size;
+        --_available_count;
+        return true;
+    }
+    
+    bool async_thread_pool::retire_excess(async_thread_worker& worker)
+    {
+        if (worker._index + 1 != _size || _size <= capacity())
+        {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        return retire(worker, capacity());
+    }
+    
+    void async_thread_pool::enter_blocking()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_blocked;
+        // A parked worker can take over, otherwise the pool is short of one worker until the region ends.
+        if (_sleeping == 0)
+        {
+            start_worker();
+        }
+    }
+    
+    void async_thread_pool::leave_blocking()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            --_blocked;
+        }
+        // The last worker retires once idle, wake it up in case it is parked already.
+        if (_size > capacity())
+        {
+            wake_all();
+        }
+    }
+    
+    // blocking_region
+    
+    // Nested regions of a task only count once.
+    static thread_local bool in_blocking_region = false;
+    
+    blocking_region::blocking_region() : _pool(current_worker != nullptr && !in_blocking_region ? current_worker->_pool : nullptr)
+    {
+        if (_pool != nullptr)
+        {
+            in_blocking_region = true;
+            _pool->enter_blocking();
+        }
+    }
+    
+    blocking_region::~blocking_region()
+    {
+        if (_pool != nullptr)
+        {
+            _pool->leave_blocking();
+            in_blocking_region = false;
+        }
+    }
+    
+    // strand
+    
+    strand::strand() : strand(get_async_thread_pool())
+    {
+    }
+    
+    strand::strand(async_thread_pool& pool) noexcept : _pool(&pool)
+    {
+    }
+    
+    strand::~strand()
+    {
+        std::uint32_t pending = _pending;
+        while (pending != 0)
+        {
+            atomic_wait(&_pending, pending);
+            pending = _pending;
+        }
+    }
+    
+    void strand::execute(executor_task&& task)
+    {
+        if (_pending++ != 0)
+        {
+            // A drain is scheduled or running, it picks the task up.
+            _tasks.push(std::move(task));
+            return;
+        }
+        // The pool decides before the task is queued, a refused task must not stay behind in the strand.
+        switch (_pool->admit())
+        {
+            case queue_gate::admission::run_inline:
+                _tasks.push(std::move(task));
+                drain();
+                return;
+            case queue_gate::admission::reject:
+                // The submissions counted in the meantime still need their drain.
+                if (_pending.fetch_sub(1) != 1)
+                {
+                    schedule();
+                }
+                throw future_error(make_error_code(future_errc::queue_full));
+            case queue_gate::admission::queue:
+                break;
+        }
+        _tasks.push(std::move(task));
+        schedule();
+    }
+    
+    void strand::schedule()
+    {
+        _pool->enqueue([this]() {
+            drain();
+        }, task_options());
+    }
+    
+    void strand::drain()
+    {
+        auto tasks = _tasks.take_all();
+        // _pending is counted before the push, so a drain can only find the queue empty while a submission is on its
+        // way in. Waiting for it beats requeueing the drain over and over until it lands.
+        while (tasks.empty())
+        {
+            this_thread::yield();
+            tasks = _tasks.take_all();
+        }
+        std::uint32_t count = 0;
+        while (!tasks.empty())
+        {
+            tasks.pop()();
+            ++count;
+        }
+        // One batch per turn, a busy strand goes back to the pool queue instead of holding on to the worker.
+        if (_pending.fetch_sub(count) != count)
+        {
+            schedule();
+        }
+        else
+        {
+            // The strand may already be destroyed, the wake up only hashes the address.
+            atomic_notify_all(&_pending);
+        }
+    }
+    
+    // run_loop
+    
+    run_loop::~run_loop()
+    {
+        poll();
+    }
+    
+    void run_loop::execute(executor_task&& task)
+    {
+        ++_pending;
+        _tasks.push(std::move(task));
+    }
+    
+    std::size_t run_loop::poll(std::chrono::nanoseconds budget)
+    {
+        const auto end = std::chrono::steady_clock::now() + budget;
+        return run([end]() {
+            return std::chrono::steady_clock::now() >= end;
+        });
+    }
+    
+    std::size_t run_loop::poll()
+    {
+        return run([]() {
+            return false;
+        });
+    }
+    
+    template<class Expired>
+    std::size_t run_loop::run(Expired&& expired)
+    {
+        std::size_t count = 0;
+        do
+        {
+            if (_backlog.empty())
+            {
+                // Tasks queued by the ones run so far are picked up too while there is budget left.
+                _backlog = _tasks.take_all();
+                if (_backlog.empty())
+                {
+                    break;
+                }
+            }
+            auto task = _backlog.pop();
+            --_pending;
+            task();
+            ++count;
         }
-        _cond.notify_one();
+        while (!expired());
+        return count;
     }
     
 } // namespace ps
@@ -41,12 +41,16 @@
 #include <chrono>
 #include <condition_variable>
 #include <cstdint>
+#include <deque>
 #include <exception>
 #include <functional>
 #include <iterator>
+#include <memory>
 #include <mutex>
-#include <queue>
+#include <optional>
+#include <set>
 #include <stdexcept>
+#include <string>
 #include <system_error>
 #include <tuple>
 #include <type_traits>
@@ -61,7 +65,9 @@ namespace ps
         future_already_retrieved = 1,
         promise_already_satisfied,
         no_state,
-        broken_promise
+        broken_promise,
+        timeout,
+        queue_full
     };
     
     enum struct launch : std::uint8_t
@@ -149,10 +155,161 @@ namespace ps
         throw future_error(make_error_code(ev));
     }
     
+    // wait_policy
+    
+    // How a thread blocked in wait, get or shared_future::get waits for a state: it spins with a pause instruction,
+    // then yields, then parks. When adaptive, the spin count is retuned after every wait from how long recent waits spun.
+    // A thread pool worker first runs other pool tasks while it waits, nested at most max_help_depth waits deep.
+    struct wait_policy
+    {
+        std::uint32_t max_spin {4096};
+        std::uint32_t max_yield {4};
+        bool adaptive {true};
+        std::uint32_t max_help_depth {16};
+    };
+    
+    void set_wait_policy(const wait_policy& policy) noexcept;
+    wait_policy get_wait_policy() noexcept;
+    
+    // task_options
+    
+    // Thread pool lane of a task. A worker always looks for critical tasks first and only runs background ones when it
+    // found nothing in the other lanes.
+    enum class priority : std::uint8_t
+    {
+        critical,
+        normal,
+        background
+    };
+    
+    constexpr std::size_t priority_count = 3;
+    
+    // Latest time at which a task is still worth running.
+    struct deadline
+    {
+        std::chrono::steady_clock::time_point time;
+        
+        inline explicit deadline(std::chrono::steady_clock::time_point t) noexcept : time(t)
+        {
+        }
+        template<class Rep, class Period>
+        inline explicit deadline(const std::chrono::duration<Rep, Period>& rel_time) : time(std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(rel_time))
+        {
+        }
+    };
+    
+    // Whether the tasks of an affinity_key may leave the worker the key maps to.
+    enum class affinity : std::uint8_t
+    {
+        none,
+        // Another worker is only woken up to steal the task once its worker has a backlog, more than two tasks of the
+        // lane queued. A worker that turns idle on its own may still take it.
+        preferred,
+        // Only the worker of the key runs the task, tasks of one key run in submission order and never overlap. A
+        // pinned task waiting on another pinned task of the same worker deadlocks, its worker does not help with them.
+        pinned
+    };
+    
+    // Sends every task of a key to the same thread pool worker so that the data of the key stays in its cache.
+    struct affinity_key
+    {
+        std::size_t hash;
+        affinity mode;
+        
+        template<class K>
+        inline explicit affinity_key(const K& key, affinity m = affinity::preferred) : hash(std::hash<K>()(key)), mode(m)
+        {
+        }
+    };
+    
+    // How a thread pool schedules a task, see async(options, launch::thread_pool, f). The other launch policies
+    // ignore it.
+    struct task_options
+    {
+        priority lane {priority::normal};
+        // Within a lane, tasks with a deadline run earliest deadline first and before the ones without. A task still
+        // queued past its deadline does not run, its future is completed with future_errc::timeout.
+        std::chrono::steady_clock::time_point due {std::chrono::steady_clock::time_point::max()};
+        // Keys map to the workers that never retire. A task with a deadline ignores its key.
+        affinity placement {affinity::none};
+        std::size_t key {0};
+        
+        inline task_options() noexcept = default;
+        inline task_options(priority p) noexcept : lane(p)
+        {
+        }
+        inline task_options(const deadline& d) noexcept : due(d.time)
+        {
+        }
+        inline task_options(const affinity_key& k) noexcept : placement(k.mode), key(k.hash)
+        {
+        }
+        
+        inline bool has_deadline() const noexcept
+        {
+            return due != std::chrono::steady_clock::time_point::max();
+        }
+    };
+    
+    // Types accepted as the first argument of async to pass task_options.
+    template<class T>
+    struct is_task_option : public std::false_type
+    {
+    };
+    
+    template<>
+    struct is_task_option<priority> : public std::true_type
+    {
+    };
+    
+    template<>
+    struct is_task_option<deadline> : public std::true_type
+    {
+    };
+    
+    template<>
+    struct is_task_option<affinity_key> : public std::true_type
+    {
+    };
+    
+    template<>
+    struct is_task_option<task_options> : public std::true_type
+    {
+    };
+    
+    // executor
+    
+    using executor_task = fu2::unique_function<void()>;
+    
+    // Anything exposing execute(executor_task&&) can run async and then continuations, it must eventually run every
+    // task it accepted.
+    template<class E, class = void>
+    struct is_executor : public std::false_type
+    {
+    };
+    
+    template<class E>
+    struct is_executor<E, std::void_t<decltype(std::declval<E&>().execute(std::declval<executor_task&&>()))>> : public std::true_type
+    {
+    };
+    
+    // Executors that also take task_options, then passes them the priority of the parent.
+    template<class E, class = void>
+    struct has_execute_options : public std::false_type
+    {
+    };
+    
+    template<class E>
+    struct has_execute_options<E, std::void_t<decltype(std::declval<E&>().execute(std::declval<executor_task&&>(), std::declval<const task_options&>()))>> : public std::true_type
+    {
+    };
+    
     // assoc_sub_state
     
     template<class T>
     class assoc_state;
+    template<class R, class Arg, class F>
+    class then_assoc_state;
     
     template<class T>
     class future;
@@ -190,24 +347,83 @@ namespace ps
     template<typename T, typename F, class Arg = future<T>>
     using future_then_t = std::conditional_t<is_future<future_then_ret_t<T, F, Arg>>::value, future_then_ret_t<T, F, Arg>, future<future_then_ret_t<T, F, Arg>>>;
     
+    // value_continuation
+    
+    // Continuation of then_value, it hands the value of the ready future to the callable without going through the
+    // error path.
+    template<class T, class F>
+    struct __attribute__((__visibility__("hidden"))) value_continuation
+    {
+        F func;
+        
+        inline decltype(auto) operator()(future<T> fut)
+        {
+            if constexpr(std::is_void<T>::value)
+            {
+                fut.get();
+                return ps::invoke(std::move(func));
+            }
+            else
+            {
+                return ps::invoke(std::move(func), fut.get());
+            }
+        }
+    };
+    
+    template<class T, class F>
+    using future_then_value_t = future_then_t<T, value_continuation<T, std::decay_t<F>>>;
+    
+    // error_continuation
+    
+    // Continuation of then_error, a value is passed through untouched and an exception is handed to the callable as
+    // an exception_ptr so that it can be recovered without rethrowing it.
+    template<class T, class F>
+    struct __attribute__((__visibility__("hidden"))) error_continuation
+    {
+        F func;
+        
+        inline T operator()(future<T> fut)
+        {
+            return fut.get();
+        }
+        inline decltype(auto) recover(const std::exception_ptr& exception)
+        {
+            return ps::invoke(std::move(func), exception);
+        }
+    };
+    
+    template<class F>
+    struct __attribute__((__visibility__("hidden"))) is_error_continuation : public std::false_type
+    {
+    };
+    
+    template<class T, class F>
+    struct __attribute__((__visibility__("hidden"))) is_error_continuation<error_continuation<T, F>> : public std::true_type
+    {
+    };
+    
     class assoc_sub_state : public shared_count
     {
     protected:
         std::exception_ptr _exception { nullptr};
-        mutable std::mutex _mut;
-        mutable std::condition_variable _cv;
-        std::atomic<std::uint8_t> _status {0};
+        mutable std::atomic<std::uint32_t> _status {0};
         fu2::unique_function<void(const std::exception_ptr&)> _continuation {nullptr};
         
         void on_zero_shared() noexcept override;
-        void sub_wait(std::unique_lock<std::mutex>& lk);
+        void sub_wait();
+        void run_deferred();
+        bool spin_wait() const;
+        void set_satisfied();
+        void set_ready(std::uint32_t flags);
         
         template<class, class>
         friend class async_assoc_state;
         template<class, class>
         friend class deferred_assoc_state;
+        template<class, class, class>
+        friend class then_assoc_state;
     public:
-        enum : std::uint8_t
+        enum : std::uint32_t
         {
             constructed = 1,
             future_attached = 2,
@@ -216,6 +432,11 @@ namespace ps
             queued = 16,
             thread_pool = 32,
             continuation_attached = 64,
+            satisfied = 128,
+            waiting = 256,
+            // Two bits holding the priority, continuations inherit it.
+            priority_shift = 9,
+            priority_mask = 3 << priority_shift,
         };
         
         inline assoc_sub_state() = default;
@@ -223,12 +444,11 @@ namespace ps
         
         inline bool has_value() const
         {
-            return ((_status & constructed) == constructed) || (_exception != nullptr);
+            return (_status & satisfied) != 0;
         }
         
         inline void set_future_attached()
         {
-            std::lock_guard<std::mutex> lk(_mut);
             _status |= future_attached;
         }
         
@@ -252,6 +472,16 @@ namespace ps
             _status |= thread_pool;
         }
         
+        inline void set_priority(priority p)
+        {
+            _status = (_status & ~static_cast<std::uint32_t>(priority_mask)) | (static_cast<std::uint32_t>(p) << priority_shift);
+        }
+        
+        inline priority get_priority() const
+        {
+            return static_cast<priority>((_status & priority_mask) >> priority_shift);
+        }
+        
         void make_ready();
         inline bool is_ready() const
         {
@@ -267,6 +497,9 @@ namespace ps
         void then_error(fu2::unique_function<void(const std::exception_ptr&)>&& continuation);
         template<class T, class F, class Arg = future<T>>
         future_then_t<T, F, Arg> then(Arg&& future, F&& func);
+        // The continuation keeps a reference to executor until this state is ready and the task is handed over.
+        template<class T, class F, class Arg = future<T>, class Executor>
+        future_then_t<T, F, Arg> then(Executor& executor, Arg&& future, F&& func);
         inline bool has_continuation() const
         {
             return (_status & continuation_attached) != 0;
@@ -281,6 +514,10 @@ namespace ps
         future_status wait_until(const std::chrono::time_point<Clock, Duration>& abs_time) const;
         
         virtual void execute();
+        // Completes a task that will not run with exception instead.
+        virtual void cancel(const std::exception_ptr& exception);
+        // Runs the task, or cancels it with future_errc::timeout once due has passed.
+        void execute_until(std::chrono::steady_clock::time_point due);
     };
     
     template<class Rep, class Period>
@@ -292,84 +529,77 @@ namespace ps
     template<class Clock, class Duration>
     future_status assoc_sub_state::wait_until(const std::chrono::time_point<Clock, Duration>& abs_time) const
     {
-        std::unique_lock<std::mutex> lk(_mut);
         if (_status & deferred)
         {
             return future_status::deferred;
         }
-        while (!(_status & ready) && Clock::now() < abs_time)
+        std::uint32_t status = _status;
+        if (status & ready)
         {
-            _cv.wait_until(lk, abs_time);
+            return future_status::ready;
         }
-        if (_status & ready)
+        status = _status.fetch_or(waiting) | waiting;
+        while (!(status & ready))
         {
-            return future_status::ready;
+            auto now = Clock::now();
+            if (now >= abs_time)
+            {
+                return future_status::timeout;
+            }
+            constexpr std::chrono::duration<long double> max_wait = std::chrono::hours(24);
+            std::chrono::nanoseconds rel_time = std::chrono::hours(24);
+            if (abs_time - now < max_wait)
+            {
+                rel_time = std::chrono::ceil<std::chrono::nanoseconds>(abs_time - now);
+            }
+            atomic_wait_for(&_status, status, rel_time);
+            status = _status;
         }
-        return future_status::timeout;
+        return future_status::ready;
     }
     
     template<class T, class F, class Arg>
     future_then_t<T, F, Arg> assoc_sub_state::then(Arg&& future, F&& func)
     {
         using R = typename future_held<future_then_ret_t<T, F, Arg>>::type;
-        promise<R> prom;
-        auto ret = prom.get_future();
-        
-        then_error([fut = std::forward<Arg>(future), p = std::move(prom), f = std::forward<F>(func)](const std::exception_ptr& exception) mutable {
-            if (exception != nullptr)
-            {
-                p.set_exception(exception);
-            }
-            else
+        using S = then_assoc_state<R, std::decay_t<Arg>, std::decay_t<F>>;
+        std::unique_ptr<S, release_shared_count> state {new S(std::forward<Arg>(future), std::forward<F>(func))};
+        state->set_priority(get_priority());
+        ps::future<R> ret(state.get());
+        then_error([s = state.release()](const std::exception_ptr& exception) {
+            s->run(exception);
+        });
+        return ret;
+    }
+    
+    template<class T, class F, class Arg, class Executor>
+    future_then_t<T, F, Arg> assoc_sub_state::then(Executor& executor, Arg&& future, F&& func)
+    {
+        using R = typename future_held<future_then_ret_t<T, F, Arg>>::type;
+        using S = then_assoc_state<R, std::decay_t<Arg>, std::decay_t<F>>;
+        std::unique_ptr<S, release_shared_count> state {new S(std::forward<Arg>(future), std::forward<F>(func))};
+        state->set_priority(get_priority());
+        ps::future<R> ret(state.get());
+        then_error([s = state.release(), &executor](const std::exception_ptr& exception) {
+            executor_task task([s, exception]() {
+                s->run(exception);
+            });
+            // The continuation runs as part of set_ready upstream, an executor refusing the task must not throw there.
+            try
             {
-                try
+                if constexpr(has_execute_options<Executor>::value)
                 {
-                    if constexpr(std::is_void<R>::value && is_future<future_then_ret_t<T, F, Arg>>::value)
-                    {
-                        ps::invoke(std::forward<F>(f), std::forward<Arg>(fut)).then_error([prom_fut = std::move(p)](const std::exception_ptr& except) mutable {
-                            if (except == nullptr)
-                            {
-                                prom_fut.set_value();
-                            }
-                            else
-                            {
-                                prom_fut.set_exception(except);
-                            }
-                        });
-                    }
-                    else if constexpr(std::is_void<R>::value && !is_future<future_then_ret_t<T, F, Arg>>::value)
-                    {
-                        ps::invoke(std::forward<F>(f), std::forward<Arg>(fut));
-                        p.set_value();
-                    }
-                    else if constexpr(!std::is_void<R>::value && !is_future<future_then_ret_t<T, F, Arg>>::value)
-                    {
-                        p.set_value(ps::invoke(std::forward<F>(f), std::forward<Arg>(fut)));
-                    }
-                    else if constexpr(!std::is_void<R>::value && is_future<future_then_ret_t<T, F, Arg>>::value)
-                    {
-                        auto fut_then = ps::invoke(std::forward<F>(f), std::forward<Arg>(fut));
-                        fut_then._state->add_shared();
-                        fut_then.then_error([prom_fut = std::move(p), t = fut_then._state](const std::exception_ptr& except) mutable {
-                            if (except == nullptr)
-                            {
-                                t->_status &= static_cast<std::uint8_t>(~future_attached);
-                                future_then_ret_t<T, F, Arg> fut_arg(t);
-                                prom_fut.set_value(fut_arg.get());
-                            }
-                            else
-                            {
-                                prom_fut.set_exception(except);
-                            }
-                            t->release_shared();
-                        });
-                    }
+                    executor.execute(std::move(task), task_options(s->get_priority()));
                 }
-                catch(...)
+                else
                 {
-                    p.set_exception(std::current_exception());
+                    executor.execute(std::move(task));
                 }
             }
+            catch (...)
+            {
+                s->cancel(std::current_exception());
+            }
         });
         return ret;
     }
@@ -410,37 +640,33 @@ namespace ps
     template<class Arg>
     void assoc_state<T>::set_value(Arg&& arg)
     {
-        bool continuation = false;
+        this->set_satisfied();
+        try
         {
-            std::unique_lock<std::mutex> lk(_mut);
-            if (has_value())
-            {
-                throw_future_error(future_errc::promise_already_satisfied);
-            }
             new (&_value) T(std::forward<Arg>(arg));
-            _status |= base::constructed | base::ready;
-            _cv.notify_all();
-            if (has_continuation())
-            {
-                continuation = true;
-            }
         }
-        if (continuation)
+        catch (...)
         {
-            _continuation(_exception);
+            _status &= static_cast<std::uint32_t>(~base::satisfied);
+            throw;
         }
+        this->set_ready(base::constructed | base::ready);
     }
     
     template<class T>
     template<class Arg>
     void assoc_state<T>::set_value_at_thread_exit(Arg&& arg)
     {
-        std::unique_lock<std::mutex> lk(_mut);
-        if (has_value())
+        this->set_satisfied();
+        try
         {
-            throw_future_error(future_errc::promise_already_satisfied);
+            new (&_value) T(std::forward<Arg>(arg));
+        }
+        catch (...)
+        {
+            _status &= static_cast<std::uint32_t>(~base::satisfied);
+            throw;
         }
-        new (&_value) T(std::forward<Arg>(arg));
         _status |= base::constructed;
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wundefined-func-template"
@@ -452,8 +678,7 @@ namespace ps
     template<class T>
     T assoc_state<T>::move()
     {
-        std::unique_lock<std::mutex> lk(_mut);
-        sub_wait(lk);
+        this->sub_wait();
         if (_exception != nullptr)
         {
             std::rethrow_exception(_exception);
@@ -464,8 +689,7 @@ namespace ps
     template<class T>
     typename std::add_lvalue_reference<T>::type assoc_state<T>::copy()
     {
-        std::unique_lock<std::mutex> lk(_mut);
-        sub_wait(lk);
+        this->sub_wait();
         if (_exception != nullptr)
         {
             std::rethrow_exception(_exception);
@@ -501,35 +725,15 @@ namespace ps
     template<class T>
     void assoc_state<T&>::set_value(T& arg)
     {
-        bool continuation = false;
-        {
-            std::unique_lock<std::mutex> lk(this->_mut);
-            if (this->has_value())
-            {
-                throw_future_error(future_errc::promise_already_satisfied);
-            }
-            _value = std::addressof(arg);
-            _status |= base::constructed | base::ready;
-            _cv.notify_all();
-            if (has_continuation())
-            {
-                continuation = true;
-            }
-        }
-        if (continuation)
-        {
-            ps::invoke(std::move(_continuation), _exception);
-        }
+        this->set_satisfied();
+        _value = std::addressof(arg);
+        this->set_ready(base::constructed | base::ready);
     }
     
     template<class T>
     void assoc_state<T&>::set_value_at_thread_exit(T& arg)
     {
-        std::unique_lock<std::mutex> lk(this->_mut);
-        if (this->has_value())
-        {
-            throw_future_error(future_errc::promise_already_satisfied);
-        }
+        this->set_satisfied();
         _value = std::addressof(arg);
         _status |= base::constructed;
 #pragma clang diagnostic push
@@ -542,8 +746,7 @@ namespace ps
     template<class T>
     T& assoc_state<T&>::copy()
     {
-        std::unique_lock<std::mutex> lk(this->_mut);
-        this->sub_wait(lk);
+        this->sub_wait();
         if (this->_exception != nullptr)
         {
             rethrow_exception(this->_exception);
@@ -632,6 +835,67 @@ namespace ps
         a.deallocate(PTraits::pointer_to(*this), 1);
     }
     
+    // once_function
+    
+    // Callable of a shared state that runs at most once. It is destroyed as soon as the call returns or throws, before
+    // the result is published, so that what it captured does not live as long as the futures sharing the state. A
+    // callable returning a reference is kept until the state goes away instead, the reference may point into it.
+    template<class F>
+    class __attribute__((__visibility__("hidden"))) once_function
+    {
+        std::optional<F> _func;
+        
+        class reset_on_exit
+        {
+        public:
+            std::optional<F>& func;
+            
+            inline ~reset_on_exit()
+            {
+                func.reset();
+            }
+        };
+        
+    public:
+        template<class... Args>
+        inline explicit once_function(std::in_place_t /*unused*/, Args&&... args) : _func(std::in_place, std::forward<Args>(args)...)
+        {
+        }
+        
+        template<class... Args>
+        inline decltype(auto) operator()(Args&&... args)
+        {
+            if constexpr(std::is_reference<decltype(ps::invoke(std::move(*_func), std::forward<Args>(args)...))>::value)
+            {
+                return ps::invoke(std::move(*_func), std::forward<Args>(args)...);
+            }
+            else
+            {
+                reset_on_exit reset {_func};
+                return ps::invoke(std::move(*_func), std::forward<Args>(args)...);
+            }
+        }
+        
+        inline decltype(auto) recover(const std::exception_ptr& exception)
+        {
+            if constexpr(std::is_reference<decltype(_func->recover(exception))>::value)
+            {
+                return _func->recover(exception);
+            }
+            else
+            {
+                reset_on_exit reset {_func};
+                return _func->recover(exception);
+            }
+        }
+        
+        // Drops the callable without running it.
+        inline void reset() noexcept
+        {
+            _func.reset();
+        }
+    };
+    
     // deferred_assoc_state
     
     template<class T, class F>
@@ -639,10 +903,11 @@ namespace ps
     {
         using base = assoc_state<T>;
         
-        F _func;
+        once_function<F> _func;
         
     public:
-        inline explicit deferred_assoc_state(F&& f) : _func(std::forward<F>(f))
+        template<class... Args>
+        inline explicit deferred_assoc_state(std::in_place_t /*unused*/, Args&&... args) : _func(std::in_place, std::forward<Args>(args)...)
         {
             this->set_deferred();
         }
@@ -656,22 +921,29 @@ namespace ps
         if constexpr(is_future<invoke_of_t<std::decay_t<F>>>::value)
         {
             auto fut = _func();
-            fut._state->add_shared();
-            this->add_shared();
-            fut.then_error([this, state = fut._state](const std::exception_ptr& exception) mutable {
-                if (exception == nullptr)
-                {
-                    state->_status &= static_cast<std::uint8_t>(~assoc_sub_state::future_attached);
-                    future<T> fut_arg(state);
-                    this->set_value(fut_arg.get());
-                }
-                else
-                {
-                    this->set_exception(exception);
-                }
-                state->release_shared();
-                this->release_shared();
-            });
+            if (fut._value.has_value())
+            {
+                this->set_value(fut.get());
+            }
+            else
+            {
+                fut._state->add_shared();
+                this->add_shared();
+                fut.on_ready([this, state = fut._state](const std::exception_ptr& exception) mutable {
+                    if (exception == nullptr)
+                    {
+                        state->_status &= static_cast<std::uint32_t>(~assoc_sub_state::future_attached);
+                        future<T> fut_arg(state);
+                        this->set_value(fut_arg.get());
+                    }
+                    else
+                    {
+                        this->set_exception(exception);
+                    }
+                    state->release_shared();
+                    this->release_shared();
+                });
+            }
         }
         else
         {
@@ -691,10 +963,11 @@ namespace ps
     {
         using base = assoc_sub_state;
         
-        F _func;
+        once_function<F> _func;
         
     public:
-        inline explicit deferred_assoc_state(F&& f) : _func(std::forward<F>(f))
+        template<class... Args>
+        inline explicit deferred_assoc_state(std::in_place_t /*unused*/, Args&&... args) : _func(std::in_place, std::forward<Args>(args)...)
         {
             set_deferred();
         }
@@ -708,32 +981,39 @@ namespace ps
         if constexpr(is_future<invoke_of_t<std::decay_t<F>>>::value)
         {
             auto fut = _func();
-            fut._state->add_shared();
-            this->add_shared();
-            fut.then_error([this, state = fut._state](const std::exception_ptr& exception) mutable {
-                if (exception == nullptr)
-                {
-                    this->set_value();
-                }
-                else
-                {
-                    this->set_exception(exception);
-                }
-                state->release_shared();
-                this->release_shared();
-            });
-        }
-        else
-        {
-            try
+            if (fut._value.has_value())
             {
-                _func();
-                set_value();
+                this->set_value();
             }
-            catch (...)
+            else
             {
-                set_exception(std::current_exception());
-            }
+                fut._state->add_shared();
+                this->add_shared();
+                fut.on_ready([this, state = fut._state](const std::exception_ptr& exception) mutable {
+                    if (exception == nullptr)
+                    {
+                        this->set_value();
+                    }
+                    else
+                    {
+                        this->set_exception(exception);
+                    }
+                    state->release_shared();
+                    this->release_shared();
+                });
+            }
+        }
+        else
+        {
+            try
+            {
+                _func();
+                set_value();
+            }
+            catch (...)
+            {
+                set_exception(std::current_exception());
+            }
         }
     }
     
@@ -744,16 +1024,19 @@ namespace ps
     {
         using base = assoc_state<T>;
         
-        F _func;
+        once_function<F> _func;
         
         void on_zero_shared() noexcept override;
     public:
-        inline explicit async_assoc_state(F&& f) : _func(std::forward<F>(f))
+        // The callable is built in place from args, see async.
+        template<class... Args>
+        inline explicit async_assoc_state(std::in_place_t /*unused*/, Args&&... args) : _func(std::in_place, std::forward<Args>(args)...)
         {
             this->add_shared();
         }
         
         void execute() override;
+        void cancel(const std::exception_ptr& exception) override;
     };
     
     template<class T, class F>
@@ -762,22 +1045,29 @@ namespace ps
         if constexpr(is_future<invoke_of_t<std::decay_t<F>>>::value)
         {
             auto fut = _func();
-            fut._state->add_shared();
-            this->add_shared();
-            fut.then_error([this, state = fut._state](const std::exception_ptr& exception) mutable {
-                if (exception == nullptr)
-                {
-                    state->_status &= static_cast<std::uint8_t>(~assoc_sub_state::future_attached);
-                    future<T> fut_arg(state);
-                    this->set_value(fut_arg.get());
-                }
-                else
-                {
-                    this->set_exception(exception);
-                }
-                state->release_shared();
-                this->release_shared();
-            });
+            if (fut._value.has_value())
+            {
+                this->set_value(fut.get());
+            }
+            else
+            {
+                fut._state->add_shared();
+                this->add_shared();
+                fut.on_ready([this, state = fut._state](const std::exception_ptr& exception) mutable {
+                    if (exception == nullptr)
+                    {
+                        state->_status &= static_cast<std::uint32_t>(~assoc_sub_state::future_attached);
+                        future<T> fut_arg(state);
+                        this->set_value(fut_arg.get());
+                    }
+                    else
+                    {
+                        this->set_exception(exception);
+                    }
+                    state->release_shared();
+                    this->release_shared();
+                });
+            }
         }
         else
         {
@@ -793,6 +1083,14 @@ namespace ps
         this->release_shared();
     }
     
+    template<class T, class F>
+    void async_assoc_state<T, F>::cancel(const std::exception_ptr& exception)
+    {
+        _func.reset();
+        this->set_exception(exception);
+        this->release_shared();
+    }
+    
     template<class T, class F>
     void async_assoc_state<T, F>::on_zero_shared() noexcept
     {
@@ -804,16 +1102,19 @@ namespace ps
     {
         using base = assoc_sub_state;
         
-        F _func;
+        once_function<F> _func;
         
         void on_zero_shared() noexcept override;
     public:
-        inline explicit async_assoc_state(F&& f) : _func(std::forward<F>(f))
+        // The callable is built in place from args, see async.
+        template<class... Args>
+        inline explicit async_assoc_state(std::in_place_t /*unused*/, Args&&... args) : _func(std::in_place, std::forward<Args>(args)...)
         {
             this->add_shared();
         }
         
         void execute() override;
+        void cancel(const std::exception_ptr& exception) override;
     };
     
     template<class F>
@@ -822,56 +1123,416 @@ namespace ps
         if constexpr(is_future<invoke_of_t<std::decay_t<F>>>::value)
         {
             auto fut = _func();
+            if (fut._value.has_value())
+            {
+                this->set_value();
+            }
+            else
+            {
+                fut._state->add_shared();
+                this->add_shared();
+                fut.on_ready([this, state = fut._state](const std::exception_ptr& exception) mutable {
+                    if (exception == nullptr)
+                    {
+                        this->set_value();
+                    }
+                    else
+                    {
+                        this->set_exception(exception);
+                    }
+                    state->release_shared();
+                    this->release_shared();
+                });
+            }
+        }
+        else
+        {
+            try
+            {
+                _func();
+                set_value();
+            }
+            catch (...)
+            {
+                set_exception(std::current_exception());
+            }
+        }
+        this->release_shared();
+    }
+    
+    template<class F>
+    void async_assoc_state<void, F>::cancel(const std::exception_ptr& exception)
+    {
+        _func.reset();
+        set_exception(exception);
+        this->release_shared();
+    }
+    
+    template<class F>
+    void async_assoc_state<void, F>::on_zero_shared() noexcept
+    {
+        base::on_zero_shared();
+    }
+    
+    // then_assoc_state
+    
+    // Shared state of the future returned by then, it also keeps the continuation and its argument so that a link
+    // in a then chain costs a single allocation.
+    template<class R, class Arg, class F>
+    class then_assoc_state : public assoc_state<R>
+    {
+        using base = assoc_state<R>;
+        
+        Arg _future;
+        once_function<F> _func;
+        
+        template<class Fut>
+        void unwrap(Fut&& fut);
+        
+    public:
+        template<class A, class G>
+        inline then_assoc_state(A&& future, G&& f) : _future(std::forward<A>(future)), _func(std::in_place, std::forward<G>(f))
+        {
+        }
+        
+        void run(const std::exception_ptr& exception);
+        // The executor refused the continuation, it completes with exception without running.
+        void cancel(const std::exception_ptr& exception) override;
+    };
+    
+    template<class R, class Arg, class F>
+    template<class Fut>
+    void then_assoc_state<R, Arg, F>::unwrap(Fut&& fut)
+    {
+        if (fut._value.has_value())
+        {
+            this->set_value(fut.get());
+        }
+        else
+        {
             fut._state->add_shared();
             this->add_shared();
-            fut.then_error([this, state = fut._state](const std::exception_ptr& exception) mutable {
-                if (exception == nullptr)
+            fut.on_ready([this, state = fut._state](const std::exception_ptr& except) mutable {
+                if (except == nullptr)
                 {
-                    this->set_value();
+                    state->_status &= static_cast<std::uint32_t>(~assoc_sub_state::future_attached);
+                    std::decay_t<Fut> fut_arg(state);
+                    this->set_value(fut_arg.get());
                 }
                 else
                 {
-                    this->set_exception(exception);
+                    this->set_exception(except);
                 }
                 state->release_shared();
                 this->release_shared();
             });
         }
-        else
+    }
+    
+    template<class R, class Arg, class F>
+    void then_assoc_state<R, Arg, F>::run(const std::exception_ptr& exception)
+    {
+        std::unique_ptr<shared_count, release_shared_count> __(this);
+        try
         {
-            try
+            if (exception == nullptr)
+            {
+                if constexpr(is_future<invoke_of_t<F, Arg>>::value)
+                {
+                    unwrap(_func(std::move(_future)));
+                }
+                else
+                {
+                    this->set_value(_func(std::move(_future)));
+                }
+            }
+            else if constexpr(is_error_continuation<F>::value)
+            {
+                if constexpr(is_future<decltype(std::declval<F&>().recover(exception))>::value)
+                {
+                    unwrap(_func.recover(exception));
+                }
+                else
+                {
+                    this->set_value(_func.recover(exception));
+                }
+            }
+            else
+            {
+                // The continuation never runs on a failed parent, drop it before publishing all the same.
+                _func.reset();
+                this->set_exception(exception);
+            }
+        }
+        catch (...)
+        {
+            this->set_exception(std::current_exception());
+        }
+        // The parent state is not needed anymore either.
+        _future = Arg();
+    }
+    
+    template<class R, class Arg, class F>
+    void then_assoc_state<R, Arg, F>::cancel(const std::exception_ptr& exception)
+    {
+        std::unique_ptr<shared_count, release_shared_count> __(this);
+        _func.reset();
+        _future = Arg();
+        this->set_exception(exception);
+    }
+    
+    template<class Arg, class F>
+    class then_assoc_state<void, Arg, F> : public assoc_sub_state
+    {
+        using base = assoc_sub_state;
+        
+        Arg _future;
+        once_function<F> _func;
+        
+        template<class Fut>
+        void unwrap(Fut&& fut);
+        
+    public:
+        template<class A, class G>
+        inline then_assoc_state(A&& future, G&& f) : _future(std::forward<A>(future)), _func(std::in_place, std::forward<G>(f))
+        {
+        }
+        
+        void run(const std::exception_ptr& exception);
+        void cancel(const std::exception_ptr& exception) override;
+    };
+    
+    template<class Arg, class F>
+    template<class Fut>
+    void then_assoc_state<void, Arg, F>::unwrap(Fut&& fut)
+    {
+        this->add_shared();
+        fut.on_ready([this](const std::exception_ptr& except) {
+            if (except == nullptr)
             {
-                _func();
                 set_value();
             }
-            catch (...)
+            else
             {
-                set_exception(std::current_exception());
+                set_exception(except);
+            }
+            this->release_shared();
+        });
+    }
+    
+    template<class Arg, class F>
+    void then_assoc_state<void, Arg, F>::run(const std::exception_ptr& exception)
+    {
+        std::unique_ptr<shared_count, release_shared_count> __(this);
+        try
+        {
+            if (exception == nullptr)
+            {
+                if constexpr(is_future<invoke_of_t<F, Arg>>::value)
+                {
+                    unwrap(_func(std::move(_future)));
+                }
+                else
+                {
+                    _func(std::move(_future));
+                    set_value();
+                }
+            }
+            else if constexpr(is_error_continuation<F>::value)
+            {
+                if constexpr(is_future<decltype(std::declval<F&>().recover(exception))>::value)
+                {
+                    unwrap(_func.recover(exception));
+                }
+                else
+                {
+                    _func.recover(exception);
+                    set_value();
+                }
+            }
+            else
+            {
+                _func.reset();
+                set_exception(exception);
             }
         }
-        this->release_shared();
+        catch (...)
+        {
+            set_exception(std::current_exception());
+        }
+        _future = Arg();
     }
     
-    template<class F>
-    void async_assoc_state<void, F>::on_zero_shared() noexcept
+    template<class Arg, class F>
+    void then_assoc_state<void, Arg, F>::cancel(const std::exception_ptr& exception)
     {
-        base::on_zero_shared();
+        std::unique_ptr<shared_count, release_shared_count> __(this);
+        _func.reset();
+        _future = Arg();
+        set_exception(exception);
     }
     
-    // queued_assoc_state
+    // mpsc_task_queue
     
-    class async_queued
+    // Lock-free multi-producer single-consumer list of tasks. Producers push with a CAS on the head and the consumer
+    // detaches everything pushed so far with a single exchange.
+    class mpsc_task_queue
+    {
+        class node
+        {
+        public:
+            executor_task task;
+            node* next;
+        };
+        
+        std::atomic<node*> _head {nullptr};
+        
+    public:
+        // Tasks detached from the queue, popped in the order they were pushed.
+        class batch
+        {
+            node* _first;
+            
+        public:
+            inline explicit batch(node* first) noexcept : _first(first)
+            {
+            }
+            batch(const batch&) = delete;
+            batch& operator=(const batch&) = delete;
+            inline batch(batch&& other) noexcept : _first(other._first)
+            {
+                other._first = nullptr;
+            }
+            inline batch& operator=(batch&& other) noexcept
+            {
+                // The tasks left in this batch go away with other.
+                std::swap(_first, other._first);
+                return *this;
+            }
+            ~batch();
+            
+            inline bool empty() const noexcept
+            {
+                return _first == nullptr;
+            }
+            executor_task pop();
+        };
+        
+        mpsc_task_queue() = default;
+        mpsc_task_queue(const mpsc_task_queue&) = delete;
+        mpsc_task_queue& operator=(const mpsc_task_queue&) = delete;
+        mpsc_task_queue(mpsc_task_queue&&) noexcept = delete;
+        mpsc_task_queue& operator=(mpsc_task_queue&&) noexcept = delete;
+        ~mpsc_task_queue();
+        
+        void push(executor_task&& task);
+        // Consumer side, only one thread at a time may take.
+        batch take_all() noexcept;
+        
+        inline bool empty() const noexcept
+        {
+            return _head.load() == nullptr;
+        }
+    };
+    
+    // queue_bounds
+    
+    // What a full queue does with a new task.
+    enum class overflow_policy : std::uint8_t
     {
-        std::queue<assoc_sub_state*> _tasks;
+        // The submitter waits for room. A task submitted from the thread draining the queue runs inline instead, waiting
+        // there could never end.
+        block,
+        // The future completes with future_errc::queue_full, execute throws it.
+        reject,
+        // The submitter runs the task itself.
+        run_inline
+    };
+    
+    struct queue_bounds
+    {
+        // Queued tasks, not counting the running ones, above which the overflow policy applies. 0 leaves the queue
+        // unbounded. The bound is checked when a task is submitted, concurrent submitters may each overshoot it by
+        // their own task or batch.
+        std::size_t capacity {0};
+        overflow_policy overflow {overflow_policy::block};
+    };
+    
+    // Applies the queue_bounds of a queue whose depth is counted by pending.
+    class queue_gate
+    {
+        std::atomic<std::size_t> _capacity {0};
+        std::atomic<overflow_policy> _overflow {overflow_policy::block};
+        // Submitters blocked on a full queue, the consumer only takes the lock to wake them up when there are some.
+        std::atomic<std::size_t> _waiting {0};
         std::mutex _mutex;
         std::condition_variable _cond;
+        
+    public:
+        enum class admission : std::uint8_t
+        {
+            queue,
+            run_inline,
+            reject
+        };
+        
+        void set_bounds(const queue_bounds& bounds);
+        queue_bounds bounds() const noexcept;
+        
+        // Decides what to do with a new task or batch, consumer is true when the caller is draining the queue itself.
+        inline admission admit(const std::atomic<std::size_t>& pending, bool consumer)
+        {
+            if (_capacity == 0 || pending < _capacity)
+            {
+                return admission::queue;
+            }
+            return overflow(pending, consumer);
+        }
+        // Called by the consumer after it took tasks off the queue.
+        inline void release()
+        {
+            if (_waiting > 0)
+            {
+                wake();
+            }
+        }
+        
+    private:
+        admission overflow(const std::atomic<std::size_t>& pending, bool consumer);
+        void wake();
+    };
+    
+    // queued_assoc_state
+    
+    class async_queued
+    {
+        mpsc_task_queue _tasks;
+        // Set by the consumer before it sleeps, producers only pay for a wake up when they clear it.
+        std::atomic<std::uint32_t> _parked {0};
+        std::atomic<bool> _stop {false};
+        std::atomic<std::size_t> _pending {0};
+        queue_gate _gate;
         ps::thread _thread;
-        bool _stop;
     public:
         async_queued();
         ~async_queued();
         
+        // Tasks queued and not started yet.
+        inline std::size_t pending() const noexcept
+        {
+            return _pending;
+        }
+        inline void set_bounds(const queue_bounds& bounds)
+        {
+            _gate.set_bounds(bounds);
+        }
+        inline queue_bounds bounds() const noexcept
+        {
+            return _gate.bounds();
+        }
+        
         void post(assoc_sub_state* state);
+        void execute(executor_task&& task);
         
         void stop();
         
@@ -879,71 +1540,515 @@ namespace ps
         void start();
     };
     
+    // async_thread_cache
+    
+    // Threads behind launch::async. Every task still gets a thread of its own, but a thread that finished its task parks
+    // for idle_timeout and is handed the next task instead of exiting. At most max_idle threads stay parked.
+    class async_thread_cache
+    {
+        class idle_thread;
+        
+        std::mutex _mutex;
+        std::condition_variable _cond;
+        std::vector<idle_thread*> _idle;
+        std::chrono::nanoseconds _idle_timeout;
+        std::size_t _max_idle;
+        std::size_t _thread_count {0};
+        bool _stop {false};
+    public:
+        explicit async_thread_cache(std::chrono::nanoseconds idle_timeout = std::chrono::seconds(10), std::size_t max_idle = 64);
+        async_thread_cache(const async_thread_cache&) = delete;
+        async_thread_cache& operator=(const async_thread_cache&) = delete;
+        async_thread_cache(async_thread_cache&&) noexcept = delete;
+        async_thread_cache& operator=(async_thread_cache&&) noexcept = delete;
+        // Wakes the parked threads and waits for the busy ones to finish their task.
+        ~async_thread_cache();
+        
+        void execute(executor_task&& task);
+        
+        void set_idle_timeout(std::chrono::nanoseconds idle_timeout);
+        std::chrono::nanoseconds idle_timeout();
+        void set_max_idle(std::size_t max_idle);
+        std::size_t max_idle();
+        // Threads alive, busy or parked.
+        std::size_t size();
+        std::size_t idle();
+        
+    private:
+        void run(executor_task&& task);
+    };
+    
     // thread_pool_assoc_state
     
+    class async_thread_pool;
+    
+    // Order in which a worker runs the tasks it queued itself, thieves always take the oldest task. Tasks submitted
+    // from outside the worker always run in FIFO order.
+    enum class queue_policy : std::uint8_t
+    {
+        lifo,
+        fifo
+    };
+    
+    // Worker range of an elastic pool. A worker is added when a queued task waited longer than spawn_latency, which is
+    // checked whenever a task is queued or picked up, and a worker parked for idle_timeout retires. The pool stays
+    // within [min_workers, max_workers].
+    struct pool_sizing
+    {
+        std::size_t min_workers {1};
+        // 0 uses one worker per hardware thread.
+        std::size_t max_workers {0};
+        std::chrono::nanoseconds spawn_latency {std::chrono::milliseconds(1)};
+        std::chrono::nanoseconds idle_timeout {std::chrono::seconds(10)};
+        // Replacement workers allowed on top of max_workers while tasks are inside a blocking_region, 0 allows one
+        // per worker.
+        std::size_t max_blocking_workers {0};
+    };
+    
     class async_thread_worker
     {
-        ps::thread _thread;
-        mutable std::mutex _m;
-        bool _stop {false};
-        std::atomic<bool> _has_task {false};
-        std::condition_variable _start_cond;
-        assoc_sub_state* _task {nullptr};
-        fu2::unique_function<void()> _completion_cb {nullptr};
     public:
-        async_thread_worker();
-        ~async_thread_worker();
+        // Tasks of an elastic pool remember when they were queued, the time is left empty otherwise.
+        class queued_task
+        {
+        public:
+            executor_task task;
+            std::chrono::steady_clock::time_point queued;
+            std::chrono::steady_clock::time_point due;
+        };
         
-        void stop();
+    private:
+        async_thread_pool* _pool;
+        std::size_t _index;
+        std::uint32_t _seed;
+        std::mutex _m;
+        // One deque per priority.
+        std::deque<queued_task> _tasks[priority_count];
+        // Tasks submitted by any other thread, run in FIFO order so that a busy worker cannot starve them.
+        std::deque<queued_task> _inbox[priority_count];
+        // Tasks of pinned affinity keys, never stolen and run in FIFO order.
+        std::deque<queued_task> _pinned[priority_count];
+        std::atomic<std::size_t> _pinned_count {0};
+        // Set while parked, a task for this worker in particular has to wake it up. Waking the worker clears it, so
+        // that the next task goes to another parked worker.
+        std::atomic<bool> _parked {false};
+        // Waited on with the _mutex of the pool while parked, every worker has its own so it can be woken alone.
+        std::condition_variable _wake;
+        // Status word of the state this worker is parked on from a wait, any task it could help with wakes it up.
+        std::atomic<const std::atomic<std::uint32_t>*> _waiting_on {nullptr};
+        ps::thread _thread;
         
-        inline bool available() const
-        {
-            return !_has_task;
-        }
+        friend class async_thread_pool;
+        friend class blocking_region;
+    public:
+        async_thread_worker(async_thread_pool* pool, std::size_t index);
+        async_thread_worker(const async_thread_worker&) = delete;
+        async_thread_worker& operator=(const async_thread_worker&) = delete;
+        async_thread_worker(async_thread_worker&&) noexcept = delete;
+        async_thread_worker& operator=(async_thread_worker&&) noexcept = delete;
+        ~async_thread_worker();
         
-        void post(assoc_sub_state* task, fu2::unique_function<void()>&& completion_cb);
+        void start();
+        void join();
+        
+        // Owner side of the deque, tasks pushed by the worker itself are popped back in LIFO order and the ones pushed
+        // by another thread go to the inbox. Both return when the oldest task of the lane was queued.
+        std::chrono::steady_clock::time_point push(executor_task&& task, std::chrono::steady_clock::time_point queued, priority lane);
+        std::chrono::steady_clock::time_point push_bulk(std::vector<executor_task>::iterator first, std::vector<executor_task>::iterator last, std::chrono::steady_clock::time_point queued, priority lane);
+        void push_pinned(executor_task&& task, std::chrono::steady_clock::time_point queued, priority lane);
+        queued_task pop_pinned(std::size_t lane);
+        // Runs one pending task of the pool from a wait on this worker, returns false when there was none.
+        bool help();
+        // Parks a waiting worker on status for at most timeout, or until a task it can help with is queued.
+        void park_waiting(const std::atomic<std::uint32_t>* status, std::uint32_t old, std::chrono::nanoseconds timeout);
+        // Own tasks first, then the inbox.
+        queued_task pop(std::size_t lane);
+        // Thief side of the deque, other workers take the oldest task of the inbox first.
+        queued_task steal(std::size_t lane);
         
     private:
-        void start_task(assoc_sub_state* task, fu2::unique_function<void()>&& completion_cb);
+        void run();
+        std::chrono::steady_clock::time_point oldest(std::size_t lane, std::chrono::steady_clock::time_point queued) const;
+        // Tasks of the lane queued on this worker, pinned ones aside.
+        std::size_t backlog(std::size_t lane);
+        std::size_t next_victim(std::size_t count);
     };
     
     class async_thread_pool
     {
-        using tp_type = std::vector<async_thread_worker>;
+        using tp_type = std::vector<std::unique_ptr<async_thread_worker>>;
         
+        // One slot per worker up to max_workers plus the blocking replacements, the running ones are the first _size.
         tp_type _tp;
+        std::string _name;
+        queue_policy _policy;
+        pool_sizing _sizing;
         std::mutex _mutex;
-        std::queue<assoc_sub_state*> _task_queue;
-        ps::thread _manager_thread;
-        bool _stop {false};
-        std::atomic<std::size_t> _available_count;
-        std::condition_variable _cond;
-        
+        std::atomic<std::size_t> _pending {0};
+        std::atomic<std::size_t> _lane_pending[priority_count] {};
+        // Pinned tasks, part of _pending but out of reach of the thieves.
+        std::atomic<std::size_t> _pinned {0};
+        // Workers parked inside a wait, see async_thread_worker::park_waiting.
+        std::atomic<std::size_t> _waiting {0};
+        // Tasks with a deadline, one heap per lane ordered earliest deadline first. They are shared by all the
+        // workers and looked at before the deques of their lane.
+        std::mutex _deadline_mutex;
+        std::vector<async_thread_worker::queued_task> _deadlines[priority_count];
+        // Queue times of the tasks of each heap, an elastic pool grows on the oldest one rather than on the most urgent.
+        std::multiset<std::chrono::steady_clock::time_point> _deadline_queued[priority_count];
+        std::atomic<std::size_t> _deadline_pending[priority_count] {};
+        queue_gate _gate;
+        std::atomic<std::size_t> _sleeping {0};
+        std::atomic<std::size_t> _next {0};
+        std::atomic<std::size_t> _available_count {0};
+        std::atomic<std::size_t> _size {0};
+        // Slots that ever ran a worker, a retired worker may still hold tasks for the others to steal.
+        std::atomic<std::size_t> _started {0};
+        std::atomic<std::chrono::steady_clock::rep> _last_grow {0};
+        // Workers inside a blocking_region.
+        std::atomic<std::size_t> _blocked {0};
+        std::atomic<bool> _stop {false};
+        
+        friend class async_thread_worker;
+        friend class blocking_region;
+        friend class strand;
     public:
         async_thread_pool();
+        // A worker_count of 0 uses one worker per hardware thread, workers are named after the pool followed by their index.
+        explicit async_thread_pool(std::size_t worker_count, std::string name = std::string(), queue_policy policy = queue_policy::lifo);
+        explicit async_thread_pool(const pool_sizing& sizing, std::string name = std::string(), queue_policy policy = queue_policy::lifo);
+        async_thread_pool(const async_thread_pool&) = delete;
+        async_thread_pool& operator=(const async_thread_pool&) = delete;
+        async_thread_pool(async_thread_pool&&) noexcept = delete;
+        async_thread_pool& operator=(async_thread_pool&&) noexcept = delete;
         ~async_thread_pool();
         
         inline std::size_t available() const
         {
             return _available_count;
         }
+        // Tasks queued and not started yet, over all the workers and lanes.
+        inline std::size_t pending() const noexcept
+        {
+            return _pending;
+        }
+        inline void set_bounds(const queue_bounds& bounds)
+        {
+            _gate.set_bounds(bounds);
+        }
+        inline queue_bounds bounds() const noexcept
+        {
+            return _gate.bounds();
+        }
+        // Running workers.
+        inline std::size_t size() const noexcept
+        {
+            return _size;
+        }
+        inline const pool_sizing& sizing() const noexcept
+        {
+            return _sizing;
+        }
+        inline bool elastic() const noexcept
+        {
+            return _sizing.min_workers < _sizing.max_workers;
+        }
+        inline const std::string& name() const noexcept
+        {
+            return _name;
+        }
+        inline queue_policy policy() const noexcept
+        {
+            return _policy;
+        }
         
+        // Queues the task in the lane of its priority.
         void post(assoc_sub_state* task);
+        void post(assoc_sub_state* task, const task_options& options);
+        void execute(executor_task&& task);
+        void execute(executor_task&& task, const task_options& options);
+        // Spreads a batch over the worker queues, each queue is locked once and only as many workers as there are
+        // tasks are woken up.
+        // A batch goes through the queue bounds at once, execute_bulk throws future_errc::queue_full before taking
+        // any task when it is rejected.
+        // The whole batch is queued in the lane of options, deadlines and affinities do not apply to batches.
+        void execute_bulk(std::vector<executor_task>&& tasks);
+        void execute_bulk(std::vector<executor_task>&& tasks, const task_options& options);
+        
+    private:
+        bool on_worker() const noexcept;
+        // Applies the queue bounds to a new task or batch.
+        queue_gate::admission admit();
+        // Wakes the worker if it is parked.
+        void wake(async_thread_worker& worker);
+        void wake_all();
+        void enqueue(executor_task&& task, const task_options& options);
+        void enqueue_bulk(std::vector<executor_task>&& tasks, priority lane);
+        // Pinned tasks are left out when helping from a wait, they would run nested in the pinned task waiting.
+        executor_task take(async_thread_worker& worker, bool pinned);
+        async_thread_worker::queued_task take_deadline(std::size_t lane);
+        bool park(async_thread_worker& worker);
+        // Queued tasks that any worker may take.
+        bool has_stealable() const noexcept;
+        // Wakes count parked workers and every worker parked inside a wait.
+        void notify(std::size_t count);
+        std::chrono::steady_clock::time_point queued_now() const;
+        // Running workers allowed right now.
+        std::size_t capacity() const noexcept;
+        // Adds a worker when a task queued at queued has been waiting longer than the spawn latency, or when a
+        // blocked worker left the pool short.
+        void grow(std::chrono::steady_clock::time_point queued);
+        // Both expect _mutex to be held.
+        bool start_worker();
+        bool retire(async_thread_worker& worker, std::size_t target);
+        
+        // These lock _mutex themselves.
+        bool retire_excess(async_thread_worker& worker);
+        void enter_blocking();
+        void leave_blocking();
+    };
+    
+    // strand
+    
+    // Serial queue on top of a thread pool: tasks run one at a time and in submission order, on whichever worker
+    // picks them up, without a thread of their own.
+    class strand
+    {
+        async_thread_pool* _pool;
+        mpsc_task_queue _tasks;
+        // Tasks submitted and not run yet, the submission that moves it from 0 schedules the drain.
+        std::atomic<std::uint32_t> _pending {0};
+        
+    public:
+        strand();
+        explicit strand(async_thread_pool& pool) noexcept;
+        strand(const strand&) = delete;
+        strand& operator=(const strand&) = delete;
+        strand(strand&&) noexcept = delete;
+        strand& operator=(strand&&) noexcept = delete;
+        // Waits for the submitted tasks to run.
+        ~strand();
+        
+        void execute(executor_task&& task);
+        
+    private:
+        // Queues a drain on the pool past its bounds, the tasks of the strand were admitted already.
+        void schedule();
+        void drain();
+    };
+    
+    // run_loop
+    
+    // Executor drained by a thread of the application, a game or render loop for instance. Tasks and then continuations
+    // sent to it run inside poll, on the thread calling poll.
+    class run_loop
+    {
+        mpsc_task_queue _tasks;
+        // Taken off _tasks and not run yet, only the polling thread touches it.
+        mpsc_task_queue::batch _backlog {nullptr};
+        std::atomic<std::size_t> _pending {0};
+        
+    public:
+        run_loop() = default;
+        run_loop(const run_loop&) = delete;
+        run_loop& operator=(const run_loop&) = delete;
+        run_loop(run_loop&&) noexcept = delete;
+        run_loop& operator=(run_loop&&) noexcept = delete;
+        // Runs what is still queued on the destroying thread.
+        ~run_loop();
+        
+        // Tasks queued and not run yet.
+        inline std::size_t pending() const noexcept
+        {
+            return _pending;
+        }
+        
+        void execute(executor_task&& task);
+        // Runs tasks in submission order until the queue is empty or budget has elapsed, the rest waits for the next
+        // call. The budget is checked between tasks, at least one task runs so that the loop always makes progress.
+        // Returns how many tasks ran.
+        std::size_t poll(std::chrono::nanoseconds budget);
+        // Runs tasks until the queue is empty.
+        std::size_t poll();
+        
+    private:
+        template<class Expired>
+        std::size_t run(Expired&& expired);
+    };
+    
+    // blocking_region
+    
+    // Tells the pool running the calling task that it is about to block, on file io or a promise fulfilled outside of
+    // the pool for instance. The pool starts a replacement worker for the lifetime of the region and retires the extra
+    // worker afterwards. Outside of a pool worker the region does nothing.
+    class blocking_region
+    {
+        async_thread_pool* _pool;
+        
+    public:
+        blocking_region();
+        blocking_region(const blocking_region&) = delete;
+        blocking_region& operator=(const blocking_region&) = delete;
+        blocking_region(blocking_region&&) noexcept = delete;
+        blocking_region& operator=(blocking_region&&) noexcept = delete;
+        ~blocking_region();
+    };
+    
+    namespace this_task
+    {
+        template<class F>
+        inline decltype(auto) blocking(F&& f)
+        {
+            blocking_region region;
+            return ps::invoke(std::forward<F>(f));
+        }
+    } // namespace this_task
+    
+    // ready_storage
+    
+    // Value of a future made ready without a shared state, so that make_ready_future and then on an already
+    // available value do not allocate.
+    template<class T>
+    class ready_storage
+    {
+        using U = typename std::aligned_storage<sizeof(T), std::alignment_of<T>::value>::type;
+    
+        U _value;
+        bool _constructed {false};
+    
+    public:
+        inline ready_storage() noexcept
+        {
+        }
+        inline ready_storage(ready_storage&& rhs) noexcept(std::is_nothrow_move_constructible<T>::value)
+        {
+            if (rhs._constructed)
+            {
+                emplace(std::move(rhs.get()));
+                rhs.reset();
+            }
+        }
+        ready_storage(const ready_storage&) = delete;
+        ready_storage& operator=(const ready_storage&) = delete;
+        inline ready_storage& operator=(ready_storage&& rhs) noexcept(std::is_nothrow_move_constructible<T>::value)
+        {
+            if (this != &rhs)
+            {
+                reset();
+                if (rhs._constructed)
+                {
+                    emplace(std::move(rhs.get()));
+                    rhs.reset();
+                }
+            }
+            return *this;
+        }
+        inline ~ready_storage()
+        {
+            reset();
+        }
+    
+        template<class Arg>
+        inline void emplace(Arg&& arg)
+        {
+            ::new(&_value) T(std::forward<Arg>(arg));
+            _constructed = true;
+        }
+        inline bool has_value() const noexcept
+        {
+            return _constructed;
+        }
+        inline T& get() noexcept
+        {
+            return *reinterpret_cast<T*>(&_value);
+        }
+        inline void reset() noexcept
+        {
+            if (_constructed)
+            {
+                get().~T();
+                _constructed = false;
+            }
+        }
+        inline void swap(ready_storage& rhs) noexcept(std::is_nothrow_move_constructible<T>::value)
+        {
+            ready_storage tmp(std::move(rhs));
+            rhs = std::move(*this);
+            *this = std::move(tmp);
+        }
+    };
+    
+    template<class T>
+    class ready_storage<T&>
+    {
+        T* _value {nullptr};
+    
+    public:
+        inline void emplace(T& arg) noexcept
+        {
+            _value = std::addressof(arg);
+        }
+        inline bool has_value() const noexcept
+        {
+            return _value != nullptr;
+        }
+        inline T& get() const noexcept
+        {
+            return *_value;
+        }
+        inline void reset() noexcept
+        {
+            _value = nullptr;
+        }
+        inline void swap(ready_storage& rhs) noexcept
+        {
+            std::swap(_value, rhs._value);
+        }
+    };
+    
+    template<>
+    class ready_storage<void>
+    {
+        bool _ready {false};
+    
+    public:
+        inline void emplace() noexcept
+        {
+            _ready = true;
+        }
+        inline bool has_value() const noexcept
+        {
+            return _ready;
+        }
+        inline void reset() noexcept
+        {
+            _ready = false;
+        }
+        inline void swap(ready_storage& rhs) noexcept
+        {
+            std::swap(_ready, rhs._ready);
+        }
     };
     
+    template<class T, class F, class Arg>
+    future_then_t<T, F, Arg> then_ready(Arg&& fut, F&& func);
+    
     // future<T>
     
     template<typename Sequence>
     struct when_any_result;
     
-    template<class T, class F>
-    future<T> make_deferred_assoc_state(F&& f);
-    template<class T, class F>
-    future<T> make_async_assoc_state(F&& f);
-    template<class T, class F>
-    future<T> make_queued_assoc_state(F&& f);
-    template<class T, class F>
-    future<T> make_thread_pool_assoc_state(F&& f);
+    template<class T, class F, class... Args>
+    future<T> make_deferred_assoc_state(Args&&... args);
+    template<class T, class F, class... Args>
+    future<T> make_async_assoc_state(bool deferred_fallback, Args&&... args);
+    template<class T, class F, class... Args>
+    future<T> make_queued_assoc_state(Args&&... args);
+    template<class T, class F, class... Args>
+    future<T> make_thread_pool_assoc_state(const task_options& options, Args&&... args);
+    template<class T, class F, class Executor, class... Args>
+    future<T> make_executor_assoc_state(Executor& executor, const task_options& options, Args&&... args);
+    struct __attribute__((__visibility__("hidden"))) bulk_collector;
     template<class T>
     std::conditional_t<is_reference_wrapper<std::decay_t<T>>::value, future<std::decay_t<T>&>, future<std::decay_t<T>>> make_ready_future(T&& value);
     
@@ -951,22 +2056,26 @@ namespace ps
     class future
     {
         assoc_state<T>* _state {nullptr};
+        ready_storage<T> _value;
         
         explicit future(assoc_state<T>* state);
+        assoc_state<T>* ensure_state();
         
         template<class>
         friend class promise;
         template<class>
         friend class shared_future;
         
-        template<class R, class F>
-        friend future<R> make_deferred_assoc_state(F&& f);
-        template<class R, class F>
-        friend future<R> make_async_assoc_state(F&& f);
-        template<class R, class F>
-        friend future<R> make_queued_assoc_state(F&& f);
-        template<class R, class F>
-        friend future<R> make_thread_pool_assoc_state(F&& f);
+        template<class R, class F, class... Args>
+        friend future<R> make_deferred_assoc_state(Args&&... args);
+        template<class R, class F, class... Args>
+        friend future<R> make_async_assoc_state(bool deferred_fallback, Args&&... args);
+        template<class R, class F, class... Args>
+        friend future<R> make_queued_assoc_state(Args&&... args);
+        template<class R, class F, class... Args>
+        friend future<R> make_thread_pool_assoc_state(const task_options& options, Args&&... args);
+        template<class R, class F, class Executor, class... Args>
+        friend future<R> make_executor_assoc_state(Executor& executor, const task_options& options, Args&&... args);
         template<typename InputIt>
         friend auto when_all(InputIt first, InputIt last) -> future<std::vector<typename std::iterator_traits<InputIt>::value_type>>;
         template<std::size_t I, typename Context, typename Future>
@@ -982,35 +2091,43 @@ namespace ps
         friend class async_assoc_state;
         template<class, class>
         friend class deferred_assoc_state;
+        template<class, class, class>
+        friend class then_assoc_state;
         
-        void then_error(fu2::unique_function<void(const std::exception_ptr&)>&& continuation);
+        void on_ready(fu2::unique_function<void(const std::exception_ptr&)>&& continuation);
         
     public:
         inline future() noexcept = default;
-        inline future(future&& rhs) noexcept : _state(rhs._state)
+        template<class Arg>
+        inline explicit future(std::in_place_t, Arg&& arg)
+        {
+            _value.emplace(std::forward<Arg>(arg));
+        }
+        inline future(future&& rhs) noexcept(std::is_nothrow_move_constructible<T>::value) : _state(rhs._state), _value(std::move(rhs._value))
         {
             rhs._state = nullptr;
         }
         future(const future&) = delete;
         future& operator=(const future&) = delete;
-        inline future& operator=(future&& rhs) noexcept
+        inline future& operator=(future&& rhs) noexcept(std::is_nothrow_move_constructible<T>::value)
         {
             future(std::move(rhs)).swap(*this);
             return *this;
         }
         ~future();
         
-        inline void swap(future& rhs) noexcept
+        inline void swap(future& rhs) noexcept(std::is_nothrow_move_constructible<T>::value)
         {
             std::swap(_state, rhs._state);
+            _value.swap(rhs._value);
         }
         
-        inline shared_future<T> share() noexcept;
+        inline shared_future<T> share();
         T get();
         
         inline bool valid() const noexcept
         {
-            return _state != nullptr;
+            return _state != nullptr || _value.has_value();
         }
         inline bool is_ready() const
         {
@@ -1018,25 +2135,44 @@ namespace ps
             {
                 return _state->is_ready();
             }
-            return false;
+            return _value.has_value();
         }
         
         template<class F>
         future_then_t<T, F> then(F&& func);
+        // func is sent to executor once this future is ready. executor is taken by reference and has to stay alive
+        // until then, even when the future is dropped earlier. The same goes for the other futures and shared futures.
+        template<class Executor, class F>
+        future_then_t<T, F> then(Executor& executor, F&& func);
+        template<class F>
+        future_then_value_t<T, F> then_value(F&& func);
+        template<class F>
+        future<T> then_error(F&& func);
         
         inline void wait() const
         {
-            _state->wait();
+            if (_state)
+            {
+                _state->wait();
+            }
         }
         template<class Rep, class Period>
         inline future_status wait_for(const std::chrono::duration<Rep, Period>& rel_time) const
         {
-            return _state->wait_for(rel_time);
+            if (_state)
+            {
+                return _state->wait_for(rel_time);
+            }
+            return future_status::ready;
         }
         template<class Clock, class Duration>
         inline future_status wait_until(const std::chrono::time_point<Clock, Duration>& abs_time) const
         {
-            return _state->wait_until(abs_time);
+            if (_state)
+            {
+                return _state->wait_until(abs_time);
+            }
+            return future_status::ready;
         }
         
     };
@@ -1061,9 +2197,29 @@ namespace ps
         }
     }
     
+    template<class T>
+    assoc_state<T>* future<T>::ensure_state()
+    {
+        if (_value.has_value())
+        {
+            std::unique_ptr<assoc_state<T>, release_shared_count> state {new assoc_state<T>()};
+            state->set_value(std::move(_value.get()));
+            state->set_future_attached();
+            _value.reset();
+            _state = state.release();
+        }
+        return _state;
+    }
+    
     template<class T>
     T future<T>::get()
     {
+        if (_value.has_value())
+        {
+            T value(std::move(_value.get()));
+            _value.reset();
+            return value;
+        }
         std::unique_ptr<shared_count, release_shared_count> __(_state);
         assoc_state<T>* s = _state;
         _state = nullptr;
@@ -1074,12 +2230,42 @@ namespace ps
     template<class F>
     future_then_t<T, F> future<T>::then(F&& func)
     {
+        if (_value.has_value())
+        {
+            return then_ready<T, F>(std::move(*this), std::forward<F>(func));
+        }
         return _state->template then<T, F>(std::move(*this), std::forward<F>(func));
     }
     
     template<class T>
-    void future<T>::then_error(fu2::unique_function<void(const std::exception_ptr&)>&& continuation)
+    template<class Executor, class F>
+    future_then_t<T, F> future<T>::then(Executor& executor, F&& func)
     {
+        return ensure_state()->template then<T, F>(executor, std::move(*this), std::forward<F>(func));
+    }
+    
+    template<class T>
+    template<class F>
+    future_then_value_t<T, F> future<T>::then_value(F&& func)
+    {
+        return then(value_continuation<T, std::decay_t<F>>{std::forward<F>(func)});
+    }
+    
+    template<class T>
+    template<class F>
+    future<T> future<T>::then_error(F&& func)
+    {
+        return then(error_continuation<T, std::decay_t<F>>{std::forward<F>(func)});
+    }
+    
+    template<class T>
+    void future<T>::on_ready(fu2::unique_function<void(const std::exception_ptr&)>&& continuation)
+    {
+        if (_value.has_value())
+        {
+            ps::invoke(std::move(continuation), nullptr);
+            return;
+        }
         return _state->then_error(std::move(continuation));
     }
     
@@ -1089,22 +2275,26 @@ namespace ps
     class future<T&>
     {
         assoc_state<T&>* _state {nullptr};
+        ready_storage<T&> _value;
         
         explicit future(assoc_state<T&>* state);
+        assoc_state<T&>* ensure_state();
         
         template<class>
         friend class promise;
         template<class>
         friend class shared_future;
         
-        template<class R, class F>
-        friend future<R> make_deferred_assoc_state(F&& f);
-        template<class R, class F>
-        friend future<R> make_async_assoc_state(F&& f);
-        template<class R, class F>
-        friend future<R> make_queued_assoc_state(F&& f);
-        template<class R, class F>
-        friend future<R> make_thread_pool_assoc_state(F&& f);
+        template<class R, class F, class... Args>
+        friend future<R> make_deferred_assoc_state(Args&&... args);
+        template<class R, class F, class... Args>
+        friend future<R> make_async_assoc_state(bool deferred_fallback, Args&&... args);
+        template<class R, class F, class... Args>
+        friend future<R> make_queued_assoc_state(Args&&... args);
+        template<class R, class F, class... Args>
+        friend future<R> make_thread_pool_assoc_state(const task_options& options, Args&&... args);
+        template<class R, class F, class Executor, class... Args>
+        friend future<R> make_executor_assoc_state(Executor& executor, const task_options& options, Args&&... args);
         template<typename InputIt>
         friend auto when_all(InputIt first, InputIt last) -> future<std::vector<typename std::iterator_traits<InputIt>::value_type>>;
         template<std::size_t I, typename Context, typename Future>
@@ -1120,14 +2310,21 @@ namespace ps
         friend class async_assoc_state;
         template<class, class>
         friend class deferred_assoc_state;
+        template<class, class, class>
+        friend class then_assoc_state;
         
-        void then_error(fu2::unique_function<void(const std::exception_ptr&)>&& continuation);
+        void on_ready(fu2::unique_function<void(const std::exception_ptr&)>&& continuation);
         
     public:
         inline future() noexcept = default;
-        inline future(future&& rhs) noexcept : _state(rhs._state)
+        inline explicit future(std::in_place_t, T& arg) noexcept
+        {
+            _value.emplace(arg);
+        }
+        inline future(future&& rhs) noexcept : _state(rhs._state), _value(rhs._value)
         {
             rhs._state = nullptr;
+            rhs._value.reset();
         }
         future(const future&) = delete;
         future& operator=(const future&) = delete;
@@ -1140,14 +2337,15 @@ namespace ps
         inline void swap(future& rhs) noexcept
         {
             std::swap(_state, rhs._state);
+            _value.swap(rhs._value);
         }
         
-        inline shared_future<T&> share() noexcept;
+        inline shared_future<T&> share();
         T& get();
         
         inline bool valid() const noexcept
         {
-            return _state != nullptr;
+            return _state != nullptr || _value.has_value();
         }
         inline bool is_ready() const
         {
@@ -1155,27 +2353,44 @@ namespace ps
             {
                 return _state->is_ready();
             }
-            return false;
+            return _value.has_value();
         }
         
         template<class F>
         future_then_t<T&, F> then(F&& func);
+        template<class Executor, class F>
+        future_then_t<T&, F> then(Executor& executor, F&& func);
+        template<class F>
+        future_then_value_t<T&, F> then_value(F&& func);
+        template<class F>
+        future<T&> then_error(F&& func);
         
         inline void wait() const
         {
-            _state->wait();
+            if (_state)
+            {
+                _state->wait();
+            }
         }
         
         template<class Rep, class Period>
         inline future_status wait_for(const std::chrono::duration<Rep, Period>& rel_time) const
         {
-            return _state->wait_for(rel_time);
+            if (_state)
+            {
+                return _state->wait_for(rel_time);
+            }
+            return future_status::ready;
         }
         
         template<class Clock, class Duration>
         inline future_status wait_until(const std::chrono::time_point<Clock, Duration>& abs_time) const
         {
-            return _state->wait_until(abs_time);
+            if (_state)
+            {
+                return _state->wait_until(abs_time);
+            }
+            return future_status::ready;
         }
     };
     
@@ -1195,13 +2410,33 @@ namespace ps
     {
         if (_state)
         {
-            _state->release_shared();
+            _state->release_shared();
+        }
+    }
+    
+    template<class T>
+    assoc_state<T&>* future<T&>::ensure_state()
+    {
+        if (_value.has_value())
+        {
+            std::unique_ptr<assoc_state<T&>, release_shared_count> state {new assoc_state<T&>()};
+            state->set_value(_value.get());
+            state->set_future_attached();
+            _value.reset();
+            _state = state.release();
         }
+        return _state;
     }
     
     template<class T>
     T& future<T&>::get()
     {
+        if (_value.has_value())
+        {
+            T& value = _value.get();
+            _value.reset();
+            return value;
+        }
         std::unique_ptr<shared_count, release_shared_count> __(_state);
         assoc_state<T&>* s = _state;
         _state = nullptr;
@@ -1212,12 +2447,42 @@ namespace ps
     template<class F>
     future_then_t<T&, F> future<T&>::then(F&& func)
     {
+        if (_value.has_value())
+        {
+            return then_ready<T&, F>(std::move(*this), std::forward<F>(func));
+        }
         return _state->template then<T&, F>(std::move(*this), std::forward<F>(func));
     }
     
     template<class T>
-    void future<T&>::then_error(fu2::unique_function<void(const std::exception_ptr&)>&& continuation)
+    template<class Executor, class F>
+    future_then_t<T&, F> future<T&>::then(Executor& executor, F&& func)
+    {
+        return ensure_state()->template then<T&, F>(executor, std::move(*this), std::forward<F>(func));
+    }
+    
+    template<class T>
+    template<class F>
+    future_then_value_t<T&, F> future<T&>::then_value(F&& func)
+    {
+        return then(value_continuation<T&, std::decay_t<F>>{std::forward<F>(func)});
+    }
+    
+    template<class T>
+    template<class F>
+    future<T&> future<T&>::then_error(F&& func)
+    {
+        return then(error_continuation<T&, std::decay_t<F>>{std::forward<F>(func)});
+    }
+    
+    template<class T>
+    void future<T&>::on_ready(fu2::unique_function<void(const std::exception_ptr&)>&& continuation)
     {
+        if (_value.has_value())
+        {
+            ps::invoke(std::move(continuation), nullptr);
+            return;
+        }
         return _state->then_error(std::move(continuation));
     }
     
@@ -1227,22 +2492,26 @@ namespace ps
     class future<void>
     {
         assoc_sub_state* _state {nullptr};
+        ready_storage<void> _value;
         
         explicit future(assoc_sub_state* state);
+        assoc_sub_state* ensure_state();
         
         template<class>
         friend class promise;
         template<class>
         friend class shared_future;
         
-        template<class R, class F>
-        friend future<R> make_deferred_assoc_state(F&& f);
-        template<class R, class F>
-        friend future<R> make_async_assoc_state(F&& f);
-        template<class R, class F>
-        friend future<R> make_queued_assoc_state(F&& f);
-        template<class R, class F>
-        friend future<R> make_thread_pool_assoc_state(F&& f);
+        template<class R, class F, class... Args>
+        friend future<R> make_deferred_assoc_state(Args&&... args);
+        template<class R, class F, class... Args>
+        friend future<R> make_async_assoc_state(bool deferred_fallback, Args&&... args);
+        template<class R, class F, class... Args>
+        friend future<R> make_queued_assoc_state(Args&&... args);
+        template<class R, class F, class... Args>
+        friend future<R> make_thread_pool_assoc_state(const task_options& options, Args&&... args);
+        template<class R, class F, class Executor, class... Args>
+        friend future<R> make_executor_assoc_state(Executor& executor, const task_options& options, Args&&... args);
         template<typename InputIt>
         friend auto when_all(InputIt first, InputIt last) -> future<std::vector<typename std::iterator_traits<InputIt>::value_type>>;
         template<std::size_t I, typename Context, typename Future>
@@ -1257,14 +2526,21 @@ namespace ps
         friend class async_assoc_state;
         template<class, class>
         friend class deferred_assoc_state;
+        template<class, class, class>
+        friend class then_assoc_state;
         
-        void then_error(fu2::unique_function<void(const std::exception_ptr&)>&& continuation);
+        void on_ready(fu2::unique_function<void(const std::exception_ptr&)>&& continuation);
         
     public:
         inline future() noexcept = default;
-        inline future(future&& rhs) noexcept : _state(rhs._state)
+        inline explicit future(std::in_place_t) noexcept
+        {
+            _value.emplace();
+        }
+        inline future(future&& rhs) noexcept : _state(rhs._state), _value(rhs._value)
         {
             rhs._state = nullptr;
+            rhs._value.reset();
         }
         future(const future&) = delete;
         future& operator=(const future&) = delete;
@@ -1278,14 +2554,15 @@ namespace ps
         inline void swap(future& rhs) noexcept
         {
             std::swap(_state, rhs._state);
+            _value.swap(rhs._value);
         }
         
-        inline shared_future<void> share() noexcept;
+        inline shared_future<void> share();
         void get();
         
         inline bool valid() const noexcept
         {
-            return _state != nullptr;
+            return _state != nullptr || _value.has_value();
         }
         inline bool is_ready() const
         {
@@ -1293,38 +2570,77 @@ namespace ps
             {
                 return _state->is_ready();
             }
-            return false;
+            return _value.has_value();
         }
         
         template<class F>
         future_then_t<void, F> then(F&& func);
+        template<class Executor, class F>
+        future_then_t<void, F> then(Executor& executor, F&& func);
+        template<class F>
+        future_then_value_t<void, F> then_value(F&& func);
+        template<class F>
+        future<void> then_error(F&& func);
         
         inline void wait() const
         {
-            _state->wait();
+            if (_state != nullptr)
+            {
+                _state->wait();
+            }
         }
         
         template<class Rep, class Period>
         inline future_status wait_for(const std::chrono::duration<Rep, Period>& rel_time) const
         {
-            return _state->wait_for(rel_time);
+            if (_state != nullptr)
+            {
+                return _state->wait_for(rel_time);
+            }
+            return future_status::ready;
         }
         
         template<class Clock, class Duration>
         inline future_status wait_until(const std::chrono::time_point<Clock, Duration>& abs_time) const
         {
-            return _state->wait_until(abs_time);
+            if (_state != nullptr)
+            {
+                return _state->wait_until(abs_time);
+            }
+            return future_status::ready;
         }
     };
     
     template<class F>
     future_then_t<void, F> future<void>::then(F&& func)
     {
+        if (_value.has_value())
+        {
+            return then_ready<void, F>(std::move(*this), std::forward<F>(func));
+        }
         return _state->template then<void, F>(std::move(*this), std::forward<F>(func));
     }
     
+    template<class Executor, class F>
+    future_then_t<void, F> future<void>::then(Executor& executor, F&& func)
+    {
+        return ensure_state()->template then<void, F>(executor, std::move(*this), std::forward<F>(func));
+    }
+    
+    template<class F>
+    future_then_value_t<void, F> future<void>::then_value(F&& func)
+    {
+        return then(value_continuation<void, std::decay_t<F>>{std::forward<F>(func)});
+    }
+    
+    template<class F>
+    future<void> future<void>::then_error(F&& func)
+    {
+        return then(error_continuation<void, std::decay_t<F>>{std::forward<F>(func)});
+    }
+    
     template<class T>
-    inline void swap(future<T>& x, future<T>& y) noexcept
+    inline void swap(future<T>& x, future<T>& y) noexcept(noexcept(x.swap(y)))
     {
         x.swap(y);
     }
@@ -1681,15 +2997,11 @@ namespace ps
         using X = std::decay_t<T>;
         if constexpr(is_reference_wrapper<X>::value)
         {
-            auto state = new assoc_state<X&>();
-            state->set_value(std::forward<T>(value));
-            return future<X&>(state);
+            return future<X&>(std::in_place, std::forward<T>(value));
         }
         else
         {
-            auto state = new assoc_state<X>();
-            state->set_value(std::forward<T>(value));
-            return future<X>(state);
+            return future<X>(std::in_place, std::forward<T>(value));
         }
     }
     
@@ -1713,6 +3025,35 @@ namespace ps
         return p.get_future();
     }
     
+    // then_ready
+    
+    template<class T, class F, class Arg>
+    future_then_t<T, F, Arg> then_ready(Arg&& fut, F&& func)
+    {
+        using Ret = future_then_ret_t<T, F, Arg>;
+        using R = typename future_held<Ret>::type;
+        try
+        {
+            if constexpr(is_future<Ret>::value)
+            {
+                return ps::invoke(std::forward<F>(func), std::forward<Arg>(fut));
+            }
+            else if constexpr(std::is_void<Ret>::value)
+            {
+                ps::invoke(std::forward<F>(func), std::forward<Arg>(fut));
+                return make_ready_future();
+            }
+            else
+            {
+                return future<Ret>(std::in_place, ps::invoke(std::forward<F>(func), std::forward<Arg>(fut)));
+            }
+        }
+        catch (...)
+        {
+            return make_exceptional_future<R>(std::current_exception());
+        }
+    }
+    
     // packaged_task_function
     
     template<class F> class packaged_task_base;
@@ -2204,30 +3545,51 @@ namespace ps
     
     // async
     
-    template<class T, class F>
-    future<T> make_deferred_assoc_state(F&& f)
+    // The make_*_assoc_state helpers build the callable F of the state in place from args.
+    template<class T, class F, class... Args>
+    future<T> make_deferred_assoc_state(Args&&... args)
     {
-        std::unique_ptr<deferred_assoc_state<T, F>, release_shared_count> h(new deferred_assoc_state<T, F>(std::forward<F>(f)));
-        h->execute();
+        std::unique_ptr<deferred_assoc_state<T, F>, release_shared_count> h(new deferred_assoc_state<T, F>(std::in_place, std::forward<Args>(args)...));
         return future<T>(h.get());
     }
     
-    template<class T, class F>
-    future<T> make_async_assoc_state(F&& f)
+    async_thread_cache& get_async_thread_cache();
+    
+    // When no thread can be started, the task runs on the caller if deferred_fallback is set, the error is thrown
+    // otherwise. That fallback stays eager, unlike launch::deferred alone which waits for the first wait, get or
+    // then: the state was built to be run and released by a thread, and an abandoned future would leak it.
+    template<class T, class F, class... Args>
+    future<T> make_async_assoc_state(bool deferred_fallback, Args&&... args)
     {
-        std::unique_ptr<async_assoc_state<T, F>, release_shared_count> h(new async_assoc_state<T, F>(std::forward<F>(f)));
-
-        ps::thread(&async_assoc_state<T, F>::execute, h.get()).detach();
-        return future<T>(h.get());
+        auto& cache = get_async_thread_cache();
+        std::unique_ptr<async_assoc_state<T, F>, release_shared_count> h(new async_assoc_state<T, F>(std::in_place, std::forward<Args>(args)...));
+        future<T> fut(h.get());
+        try
+        {
+            cache.execute([state = h.get()]() {
+                state->execute();
+            });
+        }
+        catch (...)
+        {
+            if (!deferred_fallback)
+            {
+                // Drops the reference the task would have released.
+                h->release_shared();
+                throw;
+            }
+            h->execute();
+        }
+        return fut;
     }
     
     async_queued& get_async_queued();
     
-    template<class T, class F>
-    future<T> make_queued_assoc_state(F&& f)
+    template<class T, class F, class... Args>
+    future<T> make_queued_assoc_state(Args&&... args)
     {
         auto& queue = get_async_queued();
-        std::unique_ptr<async_assoc_state<T, F>, release_shared_count> h(new async_assoc_state<T, F>(std::forward<F>(f)));
+        std::unique_ptr<async_assoc_state<T, F>, release_shared_count> h(new async_assoc_state<T, F>(std::in_place, std::forward<Args>(args)...));
         h->set_queued();
         queue.post(h.get());
         return future<T>(h.get());
@@ -2235,16 +3597,52 @@ namespace ps
     
     async_thread_pool& get_async_thread_pool();
     
-    template<class T, class F>
-    future<T> make_thread_pool_assoc_state(F&& f)
+    template<class T, class F, class... Args>
+    future<T> make_thread_pool_assoc_state(const task_options& options, Args&&... args)
     {
         auto& queue = get_async_thread_pool();
-        std::unique_ptr<async_assoc_state<T, F>, release_shared_count> h(new async_assoc_state<T, F>(std::forward<F>(f)));
+        std::unique_ptr<async_assoc_state<T, F>, release_shared_count> h(new async_assoc_state<T, F>(std::in_place, std::forward<Args>(args)...));
         h->set_thread_pool();
-        queue.post(h.get());
+        h->set_priority(options.lane);
+        queue.post(h.get(), options);
         return future<T>(h.get());
     }
     
+    template<class T, class F, class Executor, class... Args>
+    future<T> make_executor_assoc_state(Executor& executor, const task_options& options, Args&&... args)
+    {
+        std::unique_ptr<async_assoc_state<T, F>, release_shared_count> h(new async_assoc_state<T, F>(std::in_place, std::forward<Args>(args)...));
+        h->set_priority(options.lane);
+        future<T> fut(h.get());
+        executor_task task([state = h.get(), due = options.due]() {
+            state->execute_until(due);
+        });
+        if constexpr(std::is_same<Executor, bulk_collector>::value)
+        {
+            executor.execute(std::move(task), h.get());
+        }
+        else
+        {
+            // An executor throwing from execute refused the task, the future completes with its exception.
+            try
+            {
+                if constexpr(has_execute_options<Executor>::value)
+                {
+                    executor.execute(std::move(task), options);
+                }
+                else
+                {
+                    executor.execute(std::move(task));
+                }
+            }
+            catch (...)
+            {
+                h->cancel(std::current_exception());
+            }
+        }
+        return fut;
+    }
+    
     template<class F, class... Args>
     using future_async_ret_t = invoke_of_t<std::decay_t<F>, std::decay_t<Args>...>;
     
@@ -2257,7 +3655,9 @@ namespace ps
         std::tuple<F, Args...> _f;
         
     public:
-        inline explicit async_func(F&& f, Args&&... args) : _f(std::move(f), std::move(args)...)
+        // Each element is copied or moved once, straight from what the caller passed.
+        template<class G, class... A, class = std::enable_if_t<!std::is_same<std::decay_t<G>, async_func>::value>>
+        inline explicit async_func(G&& f, A&&... args) : _f(std::forward<G>(f), std::forward<A>(args)...)
         {
         }
         async_func(const async_func& f) = delete;
@@ -2299,39 +3699,269 @@ namespace ps
         
         if (does_policy_contain(policy, launch::queued))
         {
-            return make_queued_assoc_state<R>(BF(decay_copy(f), decay_copy(args)...));
+            return make_queued_assoc_state<R, BF>(std::forward<F>(f), std::forward<Args>(args)...);
         }
         else if (does_policy_contain(policy, launch::thread_pool))
         {
-            return make_thread_pool_assoc_state<R>(BF(decay_copy(f), decay_copy(args)...));
+            return make_thread_pool_assoc_state<R, BF>(task_options(), std::forward<F>(f), std::forward<Args>(args)...);
+        }
+        else if (does_policy_contain(policy, launch::async))
+        {
+            return make_async_assoc_state<R, BF>(does_policy_contain(policy, launch::deferred), std::forward<F>(f), std::forward<Args>(args)...);
+        }
+        else if (does_policy_contain(policy, launch::deferred))
+        {
+            return make_deferred_assoc_state<R, BF>(std::forward<F>(f), std::forward<Args>(args)...);
         }
+        return future<R>{};
+    }
+    
+    template<class Executor, class F, class... Args>
+    std::enable_if_t<is_executor<Executor>::value, future_async_t<F, Args...>> async(Executor& executor, F&& f, Args&&... args)
+    {
+        using R = typename future_held<future_async_ret_t<F, Args...>>::type;
+        using BF = async_func<std::decay_t<F>, std::decay_t<Args>...>;
         
-        try
+        return make_executor_assoc_state<R, BF>(executor, task_options(), std::forward<F>(f), std::forward<Args>(args)...);
+    }
+    
+    template<class F, class... Args>
+    inline std::enable_if_t<!is_executor<std::decay_t<F>>::value && !is_task_option<std::decay_t<F>>::value, future_async_t<F, Args...>> async(F&& f, Args&&... args)
+    {
+        return async(ps::launch::any, std::forward<F>(f), std::forward<Args>(args)...);
+    }
+    
+    // Only launch::thread_pool makes use of the options, the other policies behave as async(policy, f, args...).
+    template<class Option, class F, class... Args>
+    std::enable_if_t<is_task_option<Option>::value, future_async_t<F, Args...>> async(const Option& option, ps::launch policy, F&& f, Args&&... args)
+    {
+        using R = typename future_held<future_async_ret_t<F, Args...>>::type;
+        using BF = async_func<std::decay_t<F>, std::decay_t<Args>...>;
+        
+        if (!does_policy_contain(policy, launch::queued) && does_policy_contain(policy, launch::thread_pool))
+        {
+            return make_thread_pool_assoc_state<R, BF>(task_options(option), std::forward<F>(f), std::forward<Args>(args)...);
+        }
+        return async(policy, std::forward<F>(f), std::forward<Args>(args)...);
+    }
+    
+    template<class Option, class Executor, class F, class... Args>
+    std::enable_if_t<is_task_option<Option>::value && is_executor<Executor>::value, future_async_t<F, Args...>> async(const Option& option, Executor& executor, F&& f, Args&&... args)
+    {
+        using R = typename future_held<future_async_ret_t<F, Args...>>::type;
+        using BF = async_func<std::decay_t<F>, std::decay_t<Args>...>;
+        
+        return make_executor_assoc_state<R, BF>(executor, task_options(option), std::forward<F>(f), std::forward<Args>(args)...);
+    }
+    
+    // post
+    
+    // Task of post, the callable and its arguments are stored in the task itself, inline when they are small. The
+    // result is dropped here as executor_task does not compile with a callable returning a value.
+    template<class F, class... Args>
+    inline executor_task make_post_task(F&& f, Args&&... args)
+    {
+        using BF = async_func<std::decay_t<F>, std::decay_t<Args>...>;
+        
+        return executor_task([func = BF(std::forward<F>(f), std::forward<Args>(args)...)]() mutable {
+            func();
+        });
+    }
+    
+    // Fire and forget async: f is queued as a bare task, without a shared state nor a future to complete. Like for a
+    // thread, an exception escaping f terminates the program. With only launch::deferred, f runs on the caller.
+    template<class F, class... Args>
+    void post(ps::launch policy, F&& f, Args&&... args)
+    {
+        auto task = make_post_task(std::forward<F>(f), std::forward<Args>(args)...);
+        if (does_policy_contain(policy, launch::queued))
+        {
+            get_async_queued().execute(std::move(task));
+        }
+        else if (does_policy_contain(policy, launch::thread_pool))
+        {
+            get_async_thread_pool().execute(std::move(task));
+        }
+        else if (does_policy_contain(policy, launch::async))
+        {
+            get_async_thread_cache().execute(std::move(task));
+        }
+        else if (does_policy_contain(policy, launch::deferred))
+        {
+            task();
+        }
+    }
+    
+    template<class Executor, class F, class... Args>
+    std::enable_if_t<is_executor<Executor>::value> post(Executor& executor, F&& f, Args&&... args)
+    {
+        executor.execute(make_post_task(std::forward<F>(f), std::forward<Args>(args)...));
+    }
+    
+    // Only launch::thread_pool makes use of the options, a deadline orders the task but cannot expire it since there is
+    // no future to complete.
+    template<class Option, class F, class... Args>
+    std::enable_if_t<is_task_option<Option>::value> post(const Option& option, ps::launch policy, F&& f, Args&&... args)
+    {
+        if (!does_policy_contain(policy, launch::queued) && does_policy_contain(policy, launch::thread_pool))
+        {
+            get_async_thread_pool().execute(make_post_task(std::forward<F>(f), std::forward<Args>(args)...), task_options(option));
+            return;
+        }
+        post(policy, std::forward<F>(f), std::forward<Args>(args)...);
+    }
+    
+    // async_bulk
+    
+    template<class E, class = void>
+    struct __attribute__((__visibility__("hidden"))) has_execute_bulk : public std::false_type
+    {
+    };
+    
+    template<class E>
+    struct __attribute__((__visibility__("hidden"))) has_execute_bulk<E, std::void_t<decltype(std::declval<E&>().execute_bulk(std::declval<std::vector<executor_task>&&>()))>> : public std::true_type
+    {
+    };
+    
+    template<class E, class = void>
+    struct __attribute__((__visibility__("hidden"))) has_execute_bulk_options : public std::false_type
+    {
+    };
+    
+    template<class E>
+    struct __attribute__((__visibility__("hidden"))) has_execute_bulk_options<E, std::void_t<decltype(std::declval<E&>().execute_bulk(std::declval<std::vector<executor_task>&&>(), std::declval<const task_options&>()))>> : public std::true_type
+    {
+    };
+    
+    // Collects the tasks of a batch so that they are handed to the executor at once.
+    struct __attribute__((__visibility__("hidden"))) bulk_collector
+    {
+        std::vector<executor_task> tasks;
+        // State of every task, cancelled with the exception of an executor refusing it.
+        std::vector<assoc_sub_state*> states;
+        task_options options;
+        
+        inline void execute(executor_task&& task, assoc_sub_state* state)
         {
-            if (does_policy_contain(policy, launch::async))
+            tasks.push_back(std::move(task));
+            states.push_back(state);
+        }
+        
+        template<class Executor>
+        void submit(Executor& executor)
+        {
+            if constexpr(has_execute_bulk_options<Executor>::value || has_execute_bulk<Executor>::value)
+            {
+                // A batch is refused before any of its tasks is taken.
+                try
+                {
+                    if constexpr(has_execute_bulk_options<Executor>::value)
+                    {
+                        executor.execute_bulk(std::move(tasks), options);
+                    }
+                    else
+                    {
+                        executor.execute_bulk(std::move(tasks));
+                    }
+                }
+                catch (...)
+                {
+                    const auto exception = std::current_exception();
+                    for (auto* state : states)
+                    {
+                        state->cancel(exception);
+                    }
+                }
+            }
+            else
             {
-                return make_async_assoc_state<R>(BF(decay_copy(f), decay_copy(args)...));
+                for (std::size_t i = 0; i < tasks.size(); ++i)
+                {
+                    try
+                    {
+                        if constexpr(has_execute_options<Executor>::value)
+                        {
+                            executor.execute(std::move(tasks[i]), options);
+                        }
+                        else
+                        {
+                            executor.execute(std::move(tasks[i]));
+                        }
+                    }
+                    catch (...)
+                    {
+                        states[i]->cancel(std::current_exception());
+                    }
+                }
             }
+            tasks.clear();
+            states.clear();
         }
-        catch (...)
+    };
+    
+    template<class InputIt, class F>
+    using future_async_bulk_t = std::vector<future_async_t<F, typename std::iterator_traits<InputIt>::value_type>>;
+    
+    // Runs f once for every element of [first, last) and returns the futures in the same order. The option applies to
+    // every task of the batch.
+    template<class Option, class Executor, class InputIt, class F>
+    std::enable_if_t<is_task_option<Option>::value && is_executor<Executor>::value, future_async_bulk_t<InputIt, F>> async_bulk(const Option& option, Executor& executor, InputIt first, InputIt last, F&& f)
+    {
+        using Arg = typename std::iterator_traits<InputIt>::value_type;
+        using R = typename future_held<future_async_ret_t<F, Arg>>::type;
+        using BF = async_func<std::decay_t<F>, std::decay_t<Arg>>;
+        
+        future_async_bulk_t<InputIt, F> futures;
+        bulk_collector collector;
+        collector.options = task_options(option);
+        if constexpr(std::is_base_of<std::forward_iterator_tag, typename std::iterator_traits<InputIt>::iterator_category>::value)
+        {
+            const auto count = static_cast<std::size_t>(std::distance(first, last));
+            futures.reserve(count);
+            collector.tasks.reserve(count);
+            collector.states.reserve(count);
+        }
+        try
         {
-            if (policy == launch::async)
+            for (; first != last; ++first)
             {
-                throw;
+                futures.push_back(make_executor_assoc_state<R, BF>(collector, collector.options, f, *first));
             }
         }
-        
-        if (does_policy_contain(policy, launch::deferred))
+        catch (...)
         {
-            return make_deferred_assoc_state<R>(BF(decay_copy(f), decay_copy(args)...));
+            collector.submit(executor);
+            throw;
         }
-        return future<R>{};
+        collector.submit(executor);
+        return futures;
     }
     
-    template<class F, class... Args>
-    inline future_async_t<F, Args...> async(F&& f, Args&&... args)
+    template<class Executor, class InputIt, class F>
+    std::enable_if_t<is_executor<Executor>::value, future_async_bulk_t<InputIt, F>> async_bulk(Executor& executor, InputIt first, InputIt last, F&& f)
     {
-        return async(ps::launch::any, std::forward<F>(f), std::forward<Args>(args)...);
+        return async_bulk(task_options(), executor, first, last, std::forward<F>(f));
+    }
+    
+    template<class Option, class InputIt, class F>
+    std::enable_if_t<is_task_option<Option>::value, future_async_bulk_t<InputIt, F>> async_bulk(const Option& option, ps::launch policy, InputIt first, InputIt last, F&& f)
+    {
+        if (does_policy_contain(policy, launch::thread_pool) && !does_policy_contain(policy, launch::queued))
+        {
+            return async_bulk(option, get_async_thread_pool(), first, last, std::forward<F>(f));
+        }
+        future_async_bulk_t<InputIt, F> futures;
+        for (; first != last; ++first)
+        {
+            futures.push_back(async(option, policy, f, *first));
+        }
+        return futures;
+    }
+    
+    template<class InputIt, class F>
+    future_async_bulk_t<InputIt, F> async_bulk(ps::launch policy, InputIt first, InputIt last, F&& f)
+    {
+        return async_bulk(task_options(), policy, first, last, std::forward<F>(f));
     }
     
     // when_all
@@ -2360,7 +3990,7 @@ namespace ps
         for (; first != last; ++first, ++index)
         {
             shared_context->result.push_back(std::move(*first));
-            shared_context->result[index].then_error([shared_context](const std::exception_ptr exception) {
+            shared_context->result[index].on_ready([shared_context](const std::exception_ptr exception) {
                 bool delete_shared_context = false;
                 {
                     std::lock_guard<std::mutex> lock(shared_context->mutex);
@@ -2397,7 +4027,7 @@ namespace ps
     void __attribute__((__visibility__("hidden"))) when_inner_helper(Context* context, Future&& f)
     {
         std::get<I>(context->result) = std::forward<Future>(f);
-        std::get<I>(context->result).then_error([context](const std::exception_ptr exception) {
+        std::get<I>(context->result).on_ready([context](const std::exception_ptr exception) {
             bool delete_context = false;
             {
                 std::lock_guard<std::mutex> lock(context->mutex);
@@ -2497,9 +4127,9 @@ namespace ps
         
         for (size_t index = 0; first != last; ++first, ++index)
         {
-            first->_state->add_shared();
+            first->ensure_state()->add_shared();
             shared_context->result.sequence.push_back(std::move(*first));
-            shared_context->result.sequence[index].then_error([shared_context, index](const std::exception_ptr exception) {
+            shared_context->result.sequence[index].on_ready([shared_context, index](const std::exception_ptr exception) {
                 bool delete_shared_context = false;
                 {
                     std::lock_guard<std::mutex> lock(shared_context->mutex);
@@ -2587,9 +4217,9 @@ namespace ps
     template<size_t I, typename Context>
     void __attribute__((__visibility__("hidden"))) when_any_inner_helper(Context* context)
     {
-        std::get<I>(context->result.sequence)._state->add_shared();
+        std::get<I>(context->result.sequence).ensure_state()->add_shared();
         context->result_sub_state.emplace_back(static_cast<assoc_sub_state*>(std::get<I>(context->result.sequence)._state));
-        std::get<I>(context->result.sequence).then_error([context](const std::exception_ptr exception) {
+        std::get<I>(context->result.sequence).on_ready([context](const std::exception_ptr exception) {
             bool delete_context = false;
             {
                 std::lock_guard<std::mutex> lock(context->mutex);
@@ -2747,7 +4377,7 @@ namespace ps
         template<std::size_t I, typename Context, typename Future>
         friend void __attribute__((__visibility__("hidden"))) when_inner_helper(Context* context, Future&& f);
         
-        void then_error(fu2::unique_function<void(const std::exception_ptr&)>&& continuation);
+        void on_ready(fu2::unique_function<void(const std::exception_ptr&)>&& continuation);
         
     public:
         inline shared_future() noexcept : _state(nullptr)
@@ -2760,7 +4390,7 @@ namespace ps
                 _state->add_shared();
             }
         }
-        inline shared_future(future<T>&& f) noexcept : _state(f._state)
+        inline shared_future(future<T>&& f) : _state(f.ensure_state())
         {
             f._state = nullptr;
         }
@@ -2802,6 +4432,8 @@ namespace ps
         
         template<class F>
         future_then_t<T, F, shared_future<T>> then(F&& func);
+        template<class Executor, class F>
+        future_then_t<T, F, shared_future<T>> then(Executor& executor, F&& func);
         
         inline void wait() const
         {
@@ -2846,13 +4478,13 @@ namespace ps
     }
     
     template<class T>
-    inline shared_future<T> future<T>::share() noexcept
+    inline shared_future<T> future<T>::share()
     {
         return shared_future<T>(std::move(*this));
     }
     
     template<class T>
-    void shared_future<T>::then_error(fu2::unique_function<void(const std::exception_ptr&)>&& continuation)
+    void shared_future<T>::on_ready(fu2::unique_function<void(const std::exception_ptr&)>&& continuation)
     {
         return _state->then_error(std::move(continuation));
     }
@@ -2864,6 +4496,13 @@ namespace ps
         return _state->template then<T, F>(std::move(*this), std::forward<F>(func));
     }
     
+    template<class T>
+    template<class Executor, class F>
+    future_then_t<T, F, shared_future<T>> shared_future<T>::then(Executor& executor, F&& func)
+    {
+        return _state->template then<T, F>(executor, std::move(*this), std::forward<F>(func));
+    }
+    
     // shared_future<T&>
     
     template<class T>
@@ -2876,7 +4515,7 @@ namespace ps
         template<std::size_t I, typename Context, typename Future>
         friend void __attribute__((__visibility__("hidden"))) when_inner_helper(Context* context, Future&& f);
         
-        void then_error(fu2::unique_function<void(const std::exception_ptr&)>&& continuation);
+        void on_ready(fu2::unique_function<void(const std::exception_ptr&)>&& continuation);
         
     public:
         inline shared_future() noexcept : _state(nullptr)
@@ -2889,7 +4528,7 @@ namespace ps
                 _state->add_shared();
             }
         }
-        inline shared_future(future<T&>&& f) noexcept : _state(f._state)
+        inline shared_future(future<T&>&& f) : _state(f.ensure_state())
         {
             f._state = nullptr;
         }
@@ -2931,6 +4570,8 @@ namespace ps
         
         template<class F>
         future_then_t<T, F, shared_future<T>> then(F&& func);
+        template<class Executor, class F>
+        future_then_t<T, F, shared_future<T>> then(Executor& executor, F&& func);
         
         inline void wait() const
         {
@@ -2973,7 +4614,7 @@ namespace ps
     }
     
     template<class T>
-    inline shared_future<T&> future<T&>::share() noexcept
+    inline shared_future<T&> future<T&>::share()
     {
         return shared_future<T&>(std::move(*this));
     }
@@ -2986,7 +4627,14 @@ namespace ps
     }
     
     template<class T>
-    void shared_future<T&>::then_error(fu2::unique_function<void(const std::exception_ptr&)>&& continuation)
+    template<class Executor, class F>
+    future_then_t<T, F, shared_future<T>> shared_future<T&>::then(Executor& executor, F&& func)
+    {
+        return _state->template then<T, F>(executor, std::move(*this), std::forward<F>(func));
+    }
+    
+    template<class T>
+    void shared_future<T&>::on_ready(fu2::unique_function<void(const std::exception_ptr&)>&& continuation)
     {
         return _state->then_error(std::move(continuation));
     }
@@ -3003,7 +4651,7 @@ namespace ps
         template<std::size_t I, typename Context, typename Future>
         friend void __attribute__((__visibility__("hidden"))) when_inner_helper(Context* context, Future&& f);
         
-        void then_error(fu2::unique_function<void(const std::exception_ptr&)>&& continuation);
+        void on_ready(fu2::unique_function<void(const std::exception_ptr&)>&& continuation);
         
     public:
         inline shared_future() noexcept : _state(nullptr)
@@ -3016,7 +4664,7 @@ namespace ps
                 _state->add_shared();
             }
         }
-        inline shared_future(future<void>&& f) noexcept : _state(f._state)
+        inline shared_future(future<void>&& f) : _state(f.ensure_state())
         {
             f._state = nullptr;
         }
@@ -3058,6 +4706,8 @@ namespace ps
         
         template<class F>
         future_then_t<void, F, shared_future<void>> then(F&& func);
+        template<class Executor, class F>
+        future_then_t<void, F, shared_future<void>> then(Executor& executor, F&& func);
         
         inline void wait() const
         {
@@ -3081,7 +4731,13 @@ namespace ps
         return _state->template then<void, F>(std::move(*this), std::forward<F>(func));
     }
     
-    inline shared_future<void> future<void>::share() noexcept
+    template<class Executor, class F>
+    future_then_t<void, F, shared_future<void>> shared_future<void>::then(Executor& executor, F&& func)
+    {
+        return _state->template then<void, F>(executor, std::move(*this), std::forward<F>(func));
+    }
+    
+    inline shared_future<void> future<void>::share()
     {
         return shared_future<void>(std::move(*this));
     }
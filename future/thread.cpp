@@ -31,6 +31,7 @@
 
 #include "future.hpp"
 #include <cstddef>
+#include <cstring>
 #include <ctime>
 #include <limits>
 #include <sys/errno.h>
@@ -39,6 +40,11 @@
 #else
 #include <sys/sysctl.h>
 #endif
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 #include <utility>
 #include <vector>
 
@@ -87,20 +93,28 @@ namespace ps
         
         void notify_all_at_thread_exit(std::condition_variable* cv, std::mutex* m);
         void make_ready_at_thread_exit(assoc_sub_state* s);
+        void run_at_thread_exit();
     };
     
     thread_struct_imp::~thread_struct_imp()
+    {
+        run_at_thread_exit();
+    }
+    
+    void thread_struct_imp::run_at_thread_exit()
     {
         for (const auto& notify : _notify)
         {
             notify.second->unlock();
             notify.first->notify_all();
         }
+        _notify.clear();
         for (const auto& async_state : _async_states)
         {
             async_state->make_ready();
             async_state->release_shared();
         }
+        _async_states.clear();
     }
     
     void thread_struct_imp::notify_all_at_thread_exit(std::condition_variable* cv, std::mutex* m)
@@ -135,6 +149,11 @@ namespace ps
         _p->make_ready_at_thread_exit(s);
     }
     
+    void thread_struct::run_at_thread_exit()
+    {
+        _p->run_at_thread_exit();
+    }
+    
     // thread_specific_ptr
     
     thread_specific_ptr<thread_struct>& thread_local_data()
@@ -231,6 +250,105 @@ namespace ps
                 }
             }
         }
+        
+        void set_name(const char* name) noexcept
+        {
+#if defined(__APPLE__)
+            pthread_setname_np(name);
+#elif defined(__linux__) || defined(__ANDROID__)
+            char truncated[16] {};
+            std::strncpy(truncated, name, sizeof(truncated) - 1);
+            pthread_setname_np(pthread_self(), truncated);
+#else
+            static_cast<void>(name);
+#endif
+        }
     } // namespace this_thread
     
+    // atomic_wait
+    
+#if defined(__linux__)
+    
+    static timespec to_timespec(const std::chrono::nanoseconds& ns)
+    {
+        std::chrono::seconds s = std::chrono::duration_cast<std::chrono::seconds>(ns);
+        timespec ts{};
+        ts.tv_sec = static_cast<decltype(ts.tv_sec)>(s.count());
+        ts.tv_nsec = static_cast<decltype(ts.tv_nsec)>((ns - s).count());
+        return ts;
+    }
+    
+    void atomic_wait(const std::atomic<std::uint32_t>* a, std::uint32_t old) noexcept
+    {
+        syscall(SYS_futex, a, FUTEX_WAIT_PRIVATE, old, nullptr, nullptr, 0);
+    }
+    
+    bool atomic_wait_for(const std::atomic<std::uint32_t>* a, std::uint32_t old, const std::chrono::nanoseconds& rel_time) noexcept
+    {
+        if (rel_time <= std::chrono::nanoseconds::zero())
+        {
+            return false;
+        }
+        timespec ts = to_timespec(rel_time);
+        return !(syscall(SYS_futex, a, FUTEX_WAIT_PRIVATE, old, &ts, nullptr, 0) == -1 && errno == ETIMEDOUT);
+    }
+    
+    void atomic_notify_all(const std::atomic<std::uint32_t>* a) noexcept
+    {
+        syscall(SYS_futex, a, FUTEX_WAKE_PRIVATE, std::numeric_limits<int>::max(), nullptr, nullptr, 0);
+    }
+    
+#else
+    
+    // Waiters and notifiers meet on the slot the address hashes to, the value is re-checked under the slot mutex so a notification cannot be lost.
+    class __attribute__((__visibility__("hidden"))) wait_slot
+    {
+    public:
+        std::mutex m;
+        std::condition_variable cv;
+    };
+    
+    static wait_slot& get_wait_slot(const void* a)
+    {
+        static wait_slot slots[64];
+        auto h = reinterpret_cast<std::uintptr_t>(a);
+        return slots[(h >> 4) % 64];
+    }
+    
+    void atomic_wait(const std::atomic<std::uint32_t>* a, std::uint32_t old) noexcept
+    {
+        auto& slot = get_wait_slot(a);
+        std::unique_lock<std::mutex> lock(slot.m);
+        if (a->load() == old)
+        {
+            slot.cv.wait(lock);
+        }
+    }
+    
+    bool atomic_wait_for(const std::atomic<std::uint32_t>* a, std::uint32_t old, const std::chrono::nanoseconds& rel_time) noexcept
+    {
+        if (rel_time <= std::chrono::nanoseconds::zero())
+        {
+            return false;
+        }
+        auto& slot = get_wait_slot(a);
+        std::unique_lock<std::mutex> lock(slot.m);
+        if (a->load() != old)
+        {
+            return true;
+        }
+        return slot.cv.wait_for(lock, rel_time) == std::cv_status::no_timeout;
+    }
+    
+    void atomic_notify_all(const std::atomic<std::uint32_t>* a) noexcept
+    {
+        auto& slot = get_wait_slot(a);
+        {
+            std::lock_guard<std::mutex> lock(slot.m);
+        }
+        slot.cv.notify_all();
+    }
+    
+#endif
+    
 } // namespace ps
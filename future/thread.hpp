@@ -34,8 +34,10 @@
 #include <future/system_error.hpp>
 #include <future/tuple.hpp>
 
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <cstdint>
 #include <exception>
 #include <functional>
 #include <memory>
@@ -69,6 +71,8 @@ namespace ps
         
         void notify_all_at_thread_exit(std::condition_variable* cv, std::mutex* m);
         void make_ready_at_thread_exit(assoc_sub_state* s);
+        // Runs the work registered so far as if the thread exited, used by threads that are reused across tasks.
+        void run_at_thread_exit();
     };
     
     template<class T>
@@ -346,8 +350,30 @@ namespace ps
         {
             sched_yield();
         }
+        
+        // Names the calling thread for debuggers and profilers, Linux keeps the first 15 characters only.
+        void set_name(const char* name) noexcept;
+        
+        // Tells the cpu the calling thread is busy waiting, cheaper than yield for very short waits.
+        inline void relax() noexcept
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+            __asm__ __volatile__("yield");
+#endif
+        }
     } // namespace this_thread
     
+    // atomic_wait
+    
+    // Blocks while *a == old, like std::atomic<T>::wait. It may return spuriously so callers have to reload and loop.
+    // A futex is used on Linux and Android, other platforms park on a condition variable shared through a small hashed table.
+    void atomic_wait(const std::atomic<std::uint32_t>* a, std::uint32_t old) noexcept;
+    // Returns false once rel_time elapsed without a notification.
+    bool atomic_wait_for(const std::atomic<std::uint32_t>* a, std::uint32_t old, const std::chrono::nanoseconds& rel_time) noexcept;
+    void atomic_notify_all(const std::atomic<std::uint32_t>* a) noexcept;
+    
 } // namespace ps
 
 namespace std
@@ -29,9 +29,11 @@
 
 #import <XCTest/XCTest.h>
 #import <future/future.h>
+#include <atomic>
 #include <exception>
 #include <stdexcept>
 #include <chrono>
+#include <vector>
 
 @interface test_assoc_sub_state : XCTestCase
 
@@ -137,6 +139,37 @@
         te.join();
 }
 
+- (void)testWaitMany {
+    using namespace std::chrono_literals;
+
+    ps::assoc_sub_state a;
+    std::atomic<int> woken {0};
+    std::vector<ps::thread> threads;
+    for (int i = 0; i < 4; ++i)
+    {
+        threads.emplace_back([&a, &woken, i]() {
+            if (i % 2 == 0)
+            {
+                a.wait();
+            }
+            else
+            {
+                a.wait_for(1s);
+            }
+            ++woken;
+        });
+    }
+    ps::this_thread::sleep_for(5ms);
+    XCTAssertEqual(woken, 0);
+    a.set_value();
+    for (auto& t : threads)
+    {
+        if (t.joinable())
+            t.join();
+    }
+    XCTAssertEqual(woken, 4);
+}
+
 - (void)testExecute {
     ps::assoc_sub_state a;
     XCTAssertThrows(a.execute());
@@ -182,4 +215,23 @@
     XCTAssertNotEqual(i, nullptr);
 }
 
+- (void)testThenRace {
+    constexpr int count = 1000;
+    std::atomic<int> called {0};
+    for (int i = 0; i < count; ++i)
+    {
+        ps::assoc_sub_state a;
+        auto t = ps::thread([&a]() {
+            a.set_value();
+        });
+        a.then_error([&called](std::exception_ptr) {
+            ++called;
+        });
+        if (t.joinable())
+            t.join();
+        XCTAssertTrue(a.is_ready());
+    }
+    XCTAssertEqual(called, count);
+}
+
 @end
@@ -29,10 +29,170 @@
 
 #import <XCTest/XCTest.h>
 #import <future/future.h>
+#include <algorithm>
 #include <exception>
 #include <stdexcept>
 #include <string>
+#include <atomic>
+#include <condition_variable>
 #include <functional>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <set>
+#include <vector>
+
+struct manual_executor
+{
+    std::vector<ps::executor_task> tasks;
+    
+    void execute(ps::executor_task&& task)
+    {
+        tasks.push_back(std::move(task));
+    }
+    
+    std::size_t run()
+    {
+        std::size_t count = 0;
+        while (!tasks.empty())
+        {
+            auto task = std::move(tasks.front());
+            tasks.erase(tasks.begin());
+            task();
+            ++count;
+        }
+        return count;
+    }
+};
+
+// Counts how many times the payload of an argument is copied or moved.
+struct copy_counter
+{
+    static inline std::atomic<int> copies {0};
+    static inline std::atomic<int> moves {0};
+    std::vector<int> payload;
+    
+    copy_counter() : payload(1024, 1)
+    {
+    }
+    copy_counter(const copy_counter& other) : payload(other.payload)
+    {
+        ++copies;
+    }
+    copy_counter(copy_counter&& other) noexcept : payload(std::move(other.payload))
+    {
+        ++moves;
+    }
+    
+    static void reset()
+    {
+        copies = 0;
+        moves = 0;
+    }
+};
+
+// Large capture counting the live instances.
+struct tracked_buffer
+{
+    static inline std::atomic<int> alive {0};
+    std::vector<char> data;
+    
+    tracked_buffer() : data(1 << 20)
+    {
+        ++alive;
+    }
+    tracked_buffer(const tracked_buffer& other) : data(other.data)
+    {
+        ++alive;
+    }
+    tracked_buffer(tracked_buffer&& other) noexcept : data(std::move(other.data))
+    {
+        ++alive;
+    }
+    ~tracked_buffer()
+    {
+        --alive;
+    }
+};
+
+// Keeps a worker busy until release, so that the tasks submitted meanwhile queue up behind it.
+struct pool_blocker
+{
+    std::mutex m;
+    std::condition_variable cv;
+    bool released {false};
+    ps::future<void> held;
+    
+    // Takes a worker of target, an executor or a launch policy, and returns once the task holding it started.
+    template<class Target>
+    void hold(Target&& target)
+    {
+        ps::promise<void> started;
+        auto running = started.get_future();
+        held = ps::async(std::forward<Target>(target), [this, started = std::move(started)]() mutable {
+            started.set_value();
+            wait();
+        });
+        running.get();
+    }
+    
+    // Blocks the calling thread until release.
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(m);
+        cv.wait(lock, [this]() {
+            return released;
+        });
+    }
+    
+    // Lets the waiting threads go and waits for the held task to end.
+    void release()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            released = true;
+        }
+        cv.notify_all();
+        if (held.valid())
+        {
+            held.get();
+        }
+    }
+};
+
+// Task appending name to order when it runs.
+inline auto record(std::vector<std::string>& order, const char* name)
+{
+    return [&order, name]() {
+        order.emplace_back(name);
+    };
+}
+
+// Value of the future_error a future completed with, 0 when it holds a value.
+template<class Future>
+int error_code_of(Future& fut)
+{
+    try
+    {
+        fut.get();
+    }
+    catch (const ps::future_error& e)
+    {
+        return e.code().value();
+    }
+    return 0;
+}
+
+// Tells whether a thread waiting on the state went as far as parking.
+struct observed_state : ps::assoc_sub_state
+{
+    bool parked() const
+    {
+        return (_status & waiting) != 0;
+    }
+};
 
 @interface test_future : XCTestCase
 
@@ -1140,6 +1300,136 @@
     XCTAssertNotEqual(e, nullptr);
 }
 
+- (void)testThenChain {
+    using namespace std::chrono_literals;
+    
+    ps::promise<int> p1;
+    auto f1 = p1.get_future();
+    auto t1 = ps::thread([&p1]() {
+        ps::this_thread::sleep_for(1ms);
+        p1.set_value(1);
+    });
+    auto f2 = f1.then([](ps::future<int> f) {
+        return f.get() + 1;
+    }).then([](ps::future<int> f) {
+        return std::to_string(f.get());
+    }).then([](ps::future<std::string> f) {
+        return f.get() + "3";
+    }).then([](ps::future<std::string> f) {
+        return std::stoi(f.get());
+    }).then([](ps::future<int> f) {
+        return ps::async(ps::launch::async, [v = f.get()]() {
+            return v + 1;
+        });
+    }).then([](ps::future<int> f) {
+        f.get();
+    }).then([](ps::future<void> f) {
+        f.get();
+        return ps::make_ready_future(6);
+    }).then([](ps::future<int> f) {
+        return f.get() * 7;
+    });
+    XCTAssertEqual(f2.get(), 42);
+    if (t1.joinable())
+        t1.join();
+    
+    ps::promise<int> p3;
+    auto f3 = p3.get_future();
+    int calls = 0;
+    auto f4 = f3.then([&calls](ps::future<int> f) {
+        ++calls;
+        return f.get();
+    }).then([&calls](ps::future<int> f) {
+        ++calls;
+        return f.get();
+    });
+    p3.set_exception(std::make_exception_ptr(std::logic_error("logic_error")));
+    XCTAssertThrows(f4.get());
+    XCTAssertEqual(calls, 0);
+}
+
+- (void)testThenValue {
+    ps::promise<int> p1;
+    auto f1 = p1.get_future().then_value([](int v) {
+        return v * 2;
+    }).then_value([](int v) {
+        return std::to_string(v);
+    });
+    p1.set_value(21);
+    XCTAssertEqual(f1.get(), std::string("42"));
+    
+    int calls = 0;
+    ps::promise<int> p2;
+    auto f2 = p2.get_future().then_value([&calls](int v) {
+        ++calls;
+        return v;
+    });
+    p2.set_exception(std::make_exception_ptr(std::logic_error("logic_error")));
+    XCTAssertThrows(f2.get());
+    XCTAssertEqual(calls, 0);
+    
+    auto f3 = ps::make_ready_future().then_value([]() {
+        return ps::make_ready_future(3);
+    });
+    XCTAssertEqual(f3.get(), 3);
+    
+    int i = 5;
+    ps::promise<int&> p4;
+    p4.set_value(i);
+    auto f4 = p4.get_future().then_value([](int& v) -> int& {
+        ++v;
+        return v;
+    });
+    XCTAssertEqual(&f4.get(), &i);
+    XCTAssertEqual(i, 6);
+}
+
+- (void)testThenError {
+    ps::promise<int> p1;
+    std::exception_ptr e = nullptr;
+    auto f1 = p1.get_future().then_value([](int v) {
+        return v + 1;
+    }).then_error([&e](std::exception_ptr exception) {
+        e = exception;
+        return -1;
+    });
+    p1.set_exception(std::make_exception_ptr(std::logic_error("logic_error")));
+    XCTAssertEqual(f1.get(), -1);
+    XCTAssertNotEqual(e, nullptr);
+    
+    bool called = false;
+    auto f2 = ps::make_ready_future(2).then_error([&called](const std::exception_ptr&) {
+        called = true;
+        return 0;
+    });
+    XCTAssertEqual(f2.get(), 2);
+    XCTAssertFalse(called);
+    
+    ps::promise<void> p3;
+    auto f3 = p3.get_future().then_error([&called](std::exception_ptr) {
+        called = true;
+    });
+    p3.set_exception(std::make_exception_ptr(std::logic_error("logic_error")));
+    f3.get();
+    XCTAssertTrue(called);
+    
+    ps::promise<int> p4;
+    auto f4 = p4.get_future().then_error([](std::exception_ptr exception) {
+        return ps::async(ps::launch::async, [exception]() {
+            return exception != nullptr ? 7 : 0;
+        });
+    });
+    p4.set_exception(std::make_exception_ptr(std::logic_error("logic_error")));
+    XCTAssertEqual(f4.get(), 7);
+    
+    ps::promise<int> p5;
+    auto f5 = p5.get_future().then_error([](std::exception_ptr exception) -> int {
+        std::rethrow_exception(exception);
+    });
+    p5.set_exception(std::make_exception_ptr(std::logic_error("logic_error")));
+    XCTAssertThrows(f5.get());
+}
+
 - (void)testThenTReference {
     using namespace std::chrono_literals;
     
@@ -1402,7 +1692,8 @@
         ps::this_thread::sleep_for(5ms);
         return a;
     }, 42);
-    XCTAssertTrue(fut2.is_ready());
+    XCTAssertFalse(fut2.is_ready());
+    XCTAssertEqual(fut2.wait_for(0ms), ps::future_status::deferred);
     XCTAssertEqual(fut2.get(), 42);
     
     auto fut3 = ps::async(ps::launch::any, []() {
@@ -1563,7 +1854,8 @@
         ps::this_thread::sleep_for(5ms);
         i  = 42;
     });
-    XCTAssertTrue(fut2.is_ready());
+    XCTAssertFalse(fut2.is_ready());
+    XCTAssertEqual(i, 0);
     fut2.get();
     XCTAssertEqual(i, 42);
     
@@ -1668,6 +1960,1004 @@
     XCTAssertNotEqual(e, nullptr);
 }
 
+- (void)testAsyncThreadPool {
+    constexpr int count = 10000;
+    std::atomic<int> sum {0};
+    std::vector<ps::future<void>> futs;
+    futs.reserve(count);
+    for (int i = 0; i < count; ++i)
+    {
+        futs.push_back(ps::async(ps::launch::thread_pool, [&sum, i]() {
+            sum += i;
+        }));
+    }
+    ps::when_all(futs.begin(), futs.end()).get();
+    XCTAssertEqual(sum, count * (count - 1) / 2);
+
+    auto fut1 = ps::async(ps::launch::thread_pool, []() {
+        return ps::async(ps::launch::thread_pool, [](int a) {
+            return a;
+        }, 42);
+    });
+    XCTAssertEqual(fut1.get(), 42);
+
+    std::atomic<int> nested {0};
+    auto fut2 = ps::async(ps::launch::thread_pool, [&nested]() {
+        std::vector<ps::future<void>> inner;
+        for (int i = 0; i < 100; ++i)
+        {
+            inner.push_back(ps::async(ps::launch::thread_pool, [&nested]() {
+                ++nested;
+            }));
+        }
+        return ps::when_all(inner.begin(), inner.end());
+    });
+    fut2.get();
+    XCTAssertEqual(nested, 100);
+}
+
+- (void)testAsyncQueued {
+    constexpr int producers = 4;
+    constexpr int count = 2000;
+    // only touched by the queued thread
+    std::vector<int> last(producers, -1);
+    std::atomic<int> out_of_order {0};
+    std::vector<ps::future<void>> futs[producers];
+    std::vector<ps::thread> threads;
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&, p]() {
+            for (int i = 0; i < count; ++i)
+            {
+                futs[p].push_back(ps::async(ps::launch::queued, [&last, &out_of_order, p, i]() {
+                    if (last[static_cast<std::size_t>(p)] != i - 1)
+                    {
+                        ++out_of_order;
+                    }
+                    last[static_cast<std::size_t>(p)] = i;
+                }));
+            }
+        });
+    }
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    for (auto& f : futs)
+    {
+        ps::when_all(f.begin(), f.end()).get();
+    }
+    XCTAssertEqual(out_of_order, 0);
+    for (int l : last)
+    {
+        XCTAssertEqual(l, count - 1);
+    }
+}
+
+- (void)testAsyncExecutor {
+    XCTAssertTrue(ps::is_executor<manual_executor>::value);
+    XCTAssertTrue(ps::is_executor<ps::async_thread_pool>::value);
+    XCTAssertTrue(ps::is_executor<ps::async_queued>::value);
+    XCTAssertFalse(ps::is_executor<int>::value);
+    
+    manual_executor ex;
+    auto fut1 = ps::async(ex, [](int a, int b) {
+        return a + b;
+    }, 40, 1).then(ex, [](ps::future<int> f) {
+        return f.get() + 1;
+    });
+    XCTAssertFalse(fut1.is_ready());
+    XCTAssertEqual(ex.run(), static_cast<std::size_t>(2));
+    XCTAssertEqual(fut1.get(), 42);
+    
+    auto fut2 = ps::make_ready_future(21).then(ex, [](ps::future<int> f) {
+        return f.get() * 2;
+    });
+    XCTAssertFalse(fut2.is_ready());
+    ex.run();
+    XCTAssertEqual(fut2.get(), 42);
+    
+    auto caller = ps::this_thread::get_id();
+    auto fut3 = ps::async(ps::get_async_thread_pool(), [caller]() {
+        return ps::this_thread::get_id() != caller;
+    }).share();
+    auto fut4 = fut3.then(ps::get_async_queued(), [caller](ps::shared_future<bool> f) {
+        return f.get() && ps::this_thread::get_id() != caller;
+    });
+    XCTAssertTrue(fut4.get());
+    
+    auto fut5 = ps::async(ex, []() {
+        throw std::logic_error("logic_error");
+    });
+    ex.run();
+    XCTAssertThrows(fut5.get());
+}
+
+- (void)testAsyncThreadCache {
+    using namespace std::chrono_literals;
+    
+    ps::async_thread_cache cache(1s, 2);
+    XCTAssertEqual(cache.size(), static_cast<std::size_t>(0));
+    XCTAssertEqual(cache.max_idle(), static_cast<std::size_t>(2));
+    
+    auto wait_idle = [&cache](std::size_t count) {
+        for (int i = 0; i < 1000 && cache.idle() != count; ++i)
+        {
+            ps::this_thread::sleep_for(1ms);
+        }
+        return cache.idle() == count;
+    };
+
+    auto first = ps::async(cache, []() {
+        return ps::this_thread::get_id();
+    }).get();
+    XCTAssertTrue(wait_idle(1));
+    auto second = ps::async(cache, []() {
+        return ps::this_thread::get_id();
+    }).get();
+    XCTAssertTrue(first == second);
+    XCTAssertTrue(wait_idle(1));
+    XCTAssertEqual(cache.size(), static_cast<std::size_t>(1));
+    
+    // every task gets a thread of its own, even when all of them block
+    std::mutex m;
+    std::condition_variable cv;
+    int started = 0;
+    std::vector<ps::future<void>> futures;
+    for (int i = 0; i < 4; ++i)
+    {
+        futures.push_back(ps::async(cache, [&m, &cv, &started]() {
+            std::unique_lock<std::mutex> lock(m);
+            ++started;
+            cv.notify_all();
+            cv.wait(lock, [&started]() {
+                return started == 4;
+            });
+        }));
+    }
+    ps::when_all(futures.begin(), futures.end()).get();
+    XCTAssertEqual(started, 4);
+    XCTAssertTrue(wait_idle(2));
+    XCTAssertEqual(cache.size(), static_cast<std::size_t>(2));
+    
+    // work registered for thread exit runs once the task is over
+    ps::promise<int> p;
+    auto f = p.get_future();
+    ps::async(cache, [&p]() {
+        p.set_value_at_thread_exit(42);
+    }).get();
+    XCTAssertEqual(f.wait_for(1s), ps::future_status::ready);
+    XCTAssertEqual(f.get(), 42);
+    
+    cache.set_idle_timeout(1ms);
+    ps::async(cache, []() {}).get();
+    XCTAssertTrue(wait_idle(0));
+    
+    auto g = ps::async(ps::launch::async, []() {
+        ps::promise<int> q;
+        auto r = q.get_future();
+        q.set_value_at_thread_exit(7);
+        return r;
+    });
+    XCTAssertEqual(g.get(), 7);
+}
+
+- (void)testThreadPoolInstances {
+    ps::async_thread_pool render(2, "render");
+    ps::async_thread_pool io(4, "io", ps::queue_policy::fifo);
+    XCTAssertEqual(render.size(), static_cast<std::size_t>(2));
+    XCTAssertEqual(io.size(), static_cast<std::size_t>(4));
+    XCTAssertEqual(render.name(), std::string("render"));
+    XCTAssertTrue(io.policy() == ps::queue_policy::fifo);
+    XCTAssertTrue(ps::async_thread_pool().size() > 0);
+    
+    std::mutex m;
+    std::set<ps::thread::id> render_ids;
+    std::set<ps::thread::id> io_ids;
+    std::vector<ps::future<void>> futures;
+    for (int i = 0; i < 100; ++i)
+    {
+        futures.push_back(ps::async(render, [&m, &render_ids]() {
+            std::lock_guard<std::mutex> lock(m);
+            render_ids.insert(ps::this_thread::get_id());
+        }));
+        futures.push_back(ps::async(io, [&m, &io_ids]() {
+            std::lock_guard<std::mutex> lock(m);
+            io_ids.insert(ps::this_thread::get_id());
+        }));
+    }
+    ps::when_all(futures.begin(), futures.end()).get();
+    XCTAssertLessThanOrEqual(render_ids.size(), static_cast<std::size_t>(2));
+    XCTAssertLessThanOrEqual(io_ids.size(), static_cast<std::size_t>(4));
+    for (auto& id : render_ids)
+    {
+        XCTAssertEqual(io_ids.count(id), static_cast<std::size_t>(0));
+    }
+    
+    std::atomic<int> done {0};
+    {
+        ps::async_thread_pool pool(1);
+        for (int i = 0; i < 50; ++i)
+        {
+            ps::async(pool, [&done]() {
+                ++done;
+            });
+        }
+    }
+    XCTAssertEqual(done, 50);
+}
+
+- (void)testThreadPoolSubmissionOrder {
+    ps::async_thread_pool pool(1, "order");
+    std::vector<int> order;
+    
+    pool_blocker blocker;
+    blocker.hold(pool);
+    // tasks submitted from outside the pool run in submission order even with the lifo policy
+    std::vector<ps::future<void>> futs;
+    for (int i = 0; i < 8; ++i)
+    {
+        futs.push_back(ps::async(pool, [&order, i]() {
+            order.push_back(i);
+        }));
+    }
+    blocker.release();
+    ps::when_all(futs.begin(), futs.end()).get();
+    XCTAssertTrue(order == std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7}));
+    
+    // the ones a worker queues itself come back in LIFO order
+    order.clear();
+    ps::async(pool, [&pool, &order]() {
+        for (int i = 0; i < 3; ++i)
+        {
+            ps::post(pool, [&order, i]() {
+                order.push_back(i);
+            });
+        }
+    }).get();
+    ps::async(pool, []() {
+    }).get();
+    XCTAssertTrue(order == std::vector<int>({2, 1, 0}));
+}
+
+- (void)testThreadPoolElastic {
+    using namespace std::chrono_literals;
+    
+    ps::pool_sizing sizing;
+    sizing.min_workers = 1;
+    sizing.max_workers = 4;
+    sizing.spawn_latency = 1ms;
+    sizing.idle_timeout = 20ms;
+    ps::async_thread_pool pool(sizing, "elastic");
+    XCTAssertTrue(pool.elastic());
+    XCTAssertEqual(pool.size(), static_cast<std::size_t>(1));
+    XCTAssertEqual(pool.sizing().max_workers, static_cast<std::size_t>(4));
+    XCTAssertFalse(ps::async_thread_pool(2).elastic());
+    
+    std::atomic<std::size_t> peak {0};
+    std::vector<ps::future<void>> futs;
+    for (int i = 0; i < 40; ++i)
+    {
+        futs.push_back(ps::async(pool, [&pool, &peak]() {
+            ps::this_thread::sleep_for(2ms);
+            auto size = pool.size();
+            auto current = peak.load();
+            while (size > current && !peak.compare_exchange_weak(current, size))
+            {
+            }
+        }));
+    }
+    ps::when_all(futs.begin(), futs.end()).get();
+    XCTAssertGreaterThan(peak.load(), static_cast<std::size_t>(1));
+    XCTAssertLessThanOrEqual(peak.load(), static_cast<std::size_t>(4));
+    
+    for (int i = 0; i < 2000 && pool.size() > 1; ++i)
+    {
+        ps::this_thread::sleep_for(1ms);
+    }
+    XCTAssertEqual(pool.size(), static_cast<std::size_t>(1));
+    XCTAssertEqual(ps::async(pool, []() {
+        return 42;
+    }).get(), 42);
+}
+
+- (void)testThreadPoolPriority {
+    ps::async_thread_pool pool(1, "lanes", ps::queue_policy::fifo);
+    std::vector<std::string> order;
+    
+    // the only worker is held so that everything below is queued before it runs
+    pool_blocker blocker;
+    blocker.hold(pool);
+    
+    auto background = ps::async(ps::priority::background, pool, record(order, "background"));
+    auto normal = ps::async(pool, record(order, "normal"));
+    auto critical = ps::async(ps::priority::critical, pool, record(order, "critical"));
+    // the continuation inherits the critical lane and overtakes the normal task queued before it
+    auto inherited = critical.then(pool, [&order](ps::future<void>) {
+        order.emplace_back("inherited");
+    });
+    blocker.release();
+    inherited.get();
+    background.get();
+    normal.get();
+    XCTAssertEqual(order.size(), static_cast<std::size_t>(4));
+    XCTAssertEqual(order[0], std::string("critical"));
+    XCTAssertEqual(order[1], std::string("inherited"));
+    XCTAssertEqual(order[2], std::string("normal"));
+    XCTAssertEqual(order[3], std::string("background"));
+    
+    auto fut = ps::async(ps::priority::critical, ps::launch::thread_pool, []() {
+        return 42;
+    });
+    XCTAssertEqual(fut.get(), 42);
+    ps::task_options options;
+    options.lane = ps::priority::background;
+    XCTAssertEqual(ps::async(options, ps::launch::deferred, []() {
+        return 7;
+    }).get(), 7);
+}
+
+- (void)testThreadPoolDeadline {
+    using namespace std::chrono_literals;
+    
+    ps::async_thread_pool pool(1, "deadlines", ps::queue_policy::fifo);
+    std::vector<std::string> order;
+    
+    pool_blocker blocker;
+    blocker.hold(pool);
+    
+    const auto now = std::chrono::steady_clock::now();
+    auto none = ps::async(pool, record(order, "none"));
+    auto late = ps::async(ps::deadline(now + 30s), pool, record(order, "late"));
+    auto early = ps::async(ps::deadline(now + 10s), pool, record(order, "early"));
+    auto middle = ps::async(ps::deadline(now + 20s), pool, record(order, "middle"));
+    // already expired once dequeued, it must not run
+    auto stale = ps::async(ps::deadline(now - 1ms), pool, record(order, "stale"));
+    blocker.release();
+    none.get();
+    late.get();
+    early.get();
+    middle.get();
+    XCTAssertEqual(order.size(), static_cast<std::size_t>(4));
+    XCTAssertEqual(order[0], std::string("early"));
+    XCTAssertEqual(order[1], std::string("middle"));
+    XCTAssertEqual(order[2], std::string("late"));
+    XCTAssertEqual(order[3], std::string("none"));
+    XCTAssertEqual(error_code_of(stale), static_cast<int>(ps::future_errc::timeout));
+    
+    std::atomic<bool> ran {false};
+    auto expired = ps::async(ps::deadline(-1ms), ps::launch::thread_pool, [&ran]() {
+        ran = true;
+        return 42;
+    });
+    XCTAssertThrows(expired.get());
+    XCTAssertFalse(ran);
+    auto in_time = ps::async(ps::deadline(10s), ps::launch::thread_pool, []() {
+        return 42;
+    });
+    XCTAssertEqual(in_time.get(), 42);
+}
+
+- (void)testThreadPoolAffinity {
+    ps::async_thread_pool pool(3);
+    constexpr int count = 64;
+    
+    // a pinned key always runs on the same worker and in submission order
+    std::vector<ps::thread_id> threads(count);
+    std::vector<int> order;
+    std::vector<ps::future<void>> futures;
+    for (int i = 0; i < count; ++i)
+    {
+        futures.push_back(ps::async(ps::affinity_key(42, ps::affinity::pinned), pool, [&threads, &order, i]() {
+            threads[static_cast<std::size_t>(i)] = ps::this_thread::get_id();
+            order.push_back(i);
+        }));
+    }
+    for (auto& fut : futures)
+    {
+        fut.get();
+    }
+    XCTAssertTrue(std::all_of(threads.begin(), threads.end(), [&threads](const ps::thread_id& id) {
+        return id == threads.front();
+    }));
+    XCTAssertEqual(order.size(), static_cast<std::size_t>(count));
+    XCTAssertTrue(std::is_sorted(order.begin(), order.end()));
+    
+    // on a lightly loaded pool a preferred key stays on its worker, the others are not woken up to steal from it
+    // while it is busy
+    threads.clear();
+    for (int i = 0; i < count / 8; ++i)
+    {
+        ps::promise<void> gate;
+        auto busy = ps::async(ps::affinity_key(7), pool, [f = gate.get_future()]() mutable {
+            f.get();
+            return ps::this_thread::get_id();
+        });
+        auto next = ps::async(ps::affinity_key(7), pool, []() {
+            return ps::this_thread::get_id();
+        });
+        ps::this_thread::sleep_for(std::chrono::milliseconds(1));
+        gate.set_value();
+        threads.push_back(busy.get());
+        threads.push_back(next.get());
+    }
+    XCTAssertTrue(std::all_of(threads.begin(), threads.end(), [&threads](const ps::thread_id& id) {
+        return id == threads.front();
+    }));
+    
+    std::atomic<int> done {0};
+    futures.clear();
+    for (int i = 0; i < count; ++i)
+    {
+        futures.push_back(ps::async(ps::affinity_key(std::string("player") + std::to_string(i % 4)), pool, [&done]() {
+            ++done;
+        }));
+    }
+    for (auto& fut : futures)
+    {
+        fut.get();
+    }
+    XCTAssertEqual(done, count);
+    
+    // a pinned task waiting does not run the next task of its key from the wait
+    ps::promise<void> gate;
+    ps::promise<void> waiting;
+    std::vector<std::string> steps;
+    auto first = ps::async(ps::affinity_key(42, ps::affinity::pinned), pool, [&steps, &waiting, f = gate.get_future()]() mutable {
+        steps.emplace_back("first");
+        waiting.set_value();
+        f.get();
+        steps.emplace_back("first done");
+    });
+    waiting.get_future().get();
+    auto second = ps::async(ps::affinity_key(42, ps::affinity::pinned), pool, [&steps]() {
+        steps.emplace_back("second");
+    });
+    ps::this_thread::sleep_for(std::chrono::milliseconds(5));
+    gate.set_value();
+    first.get();
+    second.get();
+    XCTAssertTrue(steps == std::vector<std::string>({"first", "first done", "second"}));
+    
+    auto fut = ps::async(ps::affinity_key(7), ps::launch::thread_pool, []() {
+        return 42;
+    });
+    XCTAssertEqual(fut.get(), 42);
+}
+
+- (void)testQueueBounds {
+    using namespace std::chrono_literals;
+    
+    ps::async_thread_pool pool(1);
+    pool_blocker blocker;
+    blocker.hold(pool);
+    
+    ps::queue_bounds bounds;
+    bounds.capacity = 2;
+    bounds.overflow = ps::overflow_policy::reject;
+    pool.set_bounds(bounds);
+    XCTAssertEqual(pool.bounds().capacity, static_cast<std::size_t>(2));
+    auto first = ps::async(pool, []() {
+        return 1;
+    });
+    auto second = ps::async(pool, []() {
+        return 2;
+    });
+    XCTAssertEqual(pool.pending(), static_cast<std::size_t>(2));
+    auto rejected = ps::async(pool, []() {
+        return 3;
+    });
+    XCTAssertTrue(rejected.is_ready());
+    XCTAssertEqual(error_code_of(rejected), static_cast<int>(ps::future_errc::queue_full));
+    XCTAssertThrows(pool.execute([]() {
+    }));
+    XCTAssertEqual(pool.pending(), static_cast<std::size_t>(2));
+    // a continuation refused by the full pool completes with the same error instead of running
+    bool ran = false;
+    ps::promise<int> upstream;
+    auto chained = upstream.get_future().then(pool, [&ran](ps::future<int> f) {
+        ran = true;
+        return f.get();
+    });
+    upstream.set_value(7);
+    XCTAssertTrue(chained.is_ready());
+    XCTAssertEqual(error_code_of(chained), static_cast<int>(ps::future_errc::queue_full));
+    XCTAssertFalse(ran);
+    // so does a task sent to a strand of the pool, it does not stay queued in the strand either
+    {
+        ps::strand serial(pool);
+        auto refused = ps::async(serial, []() {
+            return 8;
+        });
+        XCTAssertTrue(refused.is_ready());
+        XCTAssertEqual(error_code_of(refused), static_cast<int>(ps::future_errc::queue_full));
+    }
+    XCTAssertEqual(pool.pending(), static_cast<std::size_t>(2));
+    
+    bounds.overflow = ps::overflow_policy::run_inline;
+    pool.set_bounds(bounds);
+    const auto caller = ps::this_thread::get_id();
+    auto inlined = ps::async(pool, [caller]() {
+        return ps::this_thread::get_id() == caller;
+    });
+    XCTAssertTrue(inlined.is_ready());
+    XCTAssertTrue(inlined.get());
+    
+    bounds.overflow = ps::overflow_policy::block;
+    pool.set_bounds(bounds);
+    std::atomic<bool> submitted {false};
+    ps::future<int> blocked;
+    auto submitter = ps::thread([&]() {
+        blocked = ps::async(pool, []() {
+            return 4;
+        });
+        submitted = true;
+    });
+    ps::this_thread::sleep_for(5ms);
+    XCTAssertFalse(submitted);
+    blocker.release();
+    if (submitter.joinable())
+        submitter.join();
+    XCTAssertTrue(submitted);
+    XCTAssertEqual(blocked.get(), 4);
+    XCTAssertEqual(first.get(), 1);
+    XCTAssertEqual(second.get(), 2);
+    
+    // a busy strand requeues its drain past the bounds, its tasks were admitted already
+    bounds.capacity = 1;
+    bounds.overflow = ps::overflow_policy::reject;
+    pool.set_bounds(bounds);
+    {
+        ps::strand serial(pool);
+        pool_blocker drain_blocker;
+        drain_blocker.hold(serial);
+        auto next = ps::async(serial, []() {
+            return 9;
+        });
+        auto other = ps::async(pool, []() {
+            return 10;
+        });
+        drain_blocker.release();
+        XCTAssertEqual(next.get(), 9);
+        XCTAssertEqual(other.get(), 10);
+    }
+    pool.set_bounds(ps::queue_bounds());
+    
+    // the queued thread rejects once its only slot is taken
+    auto& queued = ps::get_async_queued();
+    pool_blocker queued_blocker;
+    queued_blocker.hold(ps::launch::queued);
+    bounds.capacity = 1;
+    bounds.overflow = ps::overflow_policy::reject;
+    queued.set_bounds(bounds);
+    auto queued_first = ps::async(ps::launch::queued, []() {
+        return 5;
+    });
+    XCTAssertEqual(queued.pending(), static_cast<std::size_t>(1));
+    auto queued_rejected = ps::async(ps::launch::queued, []() {
+        return 6;
+    });
+    XCTAssertEqual(error_code_of(queued_rejected), static_cast<int>(ps::future_errc::queue_full));
+    queued.set_bounds(ps::queue_bounds());
+    queued_blocker.release();
+    XCTAssertEqual(queued_first.get(), 5);
+}
+
+- (void)testRunLoop {
+    using namespace std::chrono_literals;
+    
+    ps::run_loop loop;
+    const auto owner = ps::this_thread::get_id();
+    std::vector<int> order;
+    auto first = ps::async(loop, [&order, owner]() {
+        order.push_back(1);
+        return ps::this_thread::get_id() == owner;
+    });
+    // continuations of a pool task come back to the loop
+    auto second = ps::async(ps::launch::thread_pool, []() {
+        return 2;
+    }).then(loop, [&order, owner](ps::future<int> fut) {
+        order.push_back(fut.get());
+        return ps::this_thread::get_id() == owner;
+    });
+    XCTAssertFalse(first.is_ready());
+    
+    // a budget already used up still runs one task
+    XCTAssertEqual(loop.poll(0ns), static_cast<std::size_t>(1));
+    XCTAssertTrue(first.is_ready());
+    XCTAssertTrue(first.get());
+    while (!second.is_ready())
+    {
+        loop.poll(1ms);
+    }
+    XCTAssertTrue(second.get());
+    XCTAssertTrue(order == std::vector<int>({1, 2}));
+    XCTAssertEqual(loop.pending(), static_cast<std::size_t>(0));
+    
+    // slow tasks are spread over several frames
+    std::atomic<int> ran {0};
+    for (int i = 0; i < 10; ++i)
+    {
+        loop.execute([&ran]() {
+            ps::this_thread::sleep_for(2ms);
+            ++ran;
+        });
+    }
+    XCTAssertEqual(loop.pending(), static_cast<std::size_t>(10));
+    const auto frame = loop.poll(5ms);
+    XCTAssertGreaterThan(frame, static_cast<std::size_t>(0));
+    XCTAssertLessThan(frame, static_cast<std::size_t>(10));
+    XCTAssertEqual(loop.pending(), 10 - frame);
+    XCTAssertEqual(loop.poll(), 10 - frame);
+    XCTAssertEqual(ran, 10);
+}
+
+- (void)testPost {
+    using namespace std::chrono_literals;
+    
+    std::atomic<int> done {0};
+    ps::post(ps::launch::thread_pool, [&done]() {
+        ++done;
+    });
+    // arguments are moved into the task and the result is dropped
+    ps::post(ps::launch::thread_pool, [&done](int value, std::unique_ptr<int> ptr) {
+        done += value + *ptr;
+        return value;
+    }, 1, std::make_unique<int>(1));
+    ps::post(ps::priority::critical, ps::launch::thread_pool, [&done]() {
+        ++done;
+    });
+    ps::post(ps::launch::queued, [&done]() {
+        ++done;
+    });
+    ps::post(ps::launch::async, [&done]() {
+        ++done;
+    });
+    ps::post(ps::launch::deferred, [&done]() {
+        ++done;
+    });
+    ps::async_thread_pool pool(1);
+    ps::post(pool, [&done]() {
+        ++done;
+    });
+    ps::run_loop loop;
+    ps::post(loop, [&done]() {
+        ++done;
+    });
+    XCTAssertEqual(loop.poll(), static_cast<std::size_t>(1));
+    for (int i = 0; i < 1000 && done != 9; ++i)
+    {
+        ps::this_thread::sleep_for(1ms);
+    }
+    XCTAssertEqual(done, 9);
+}
+
+- (void)testAsyncForwarding {
+    auto sum = [](const copy_counter& counter) {
+        return std::accumulate(counter.payload.begin(), counter.payload.end(), 0);
+    };
+
+    // rvalue arguments and callables are moved into the shared state, never copied
+    for (auto policy : {ps::launch::async, ps::launch::deferred, ps::launch::queued, ps::launch::thread_pool})
+    {
+        copy_counter::reset();
+        auto fut = ps::async(policy, [sum](copy_counter counter) {
+            return sum(counter);
+        }, copy_counter());
+        XCTAssertEqual(fut.get(), 1024);
+        XCTAssertEqual(copy_counter::copies, 0);
+        // once into the state and once into the parameter of the callable
+        XCTAssertEqual(copy_counter::moves, 2);
+    }
+    
+    copy_counter::reset();
+    manual_executor executor;
+    auto captured = ps::async(executor, [sum, counter = copy_counter()]() {
+        return sum(counter);
+    });
+    executor.run();
+    XCTAssertEqual(captured.get(), 1024);
+    XCTAssertEqual(copy_counter::copies, 0);
+    
+    // an lvalue is copied exactly once
+    copy_counter::reset();
+    copy_counter kept;
+    auto copied = ps::async(ps::launch::thread_pool, [sum](const copy_counter& counter) {
+        return sum(counter);
+    }, kept);
+    XCTAssertEqual(copied.get(), 1024);
+    XCTAssertEqual(copy_counter::copies, 1);
+    XCTAssertEqual(copy_counter::moves, 0);
+    
+    // move-only captures no longer need a shared_future
+    auto inner = ps::async(ps::launch::thread_pool, []() {
+        return 21;
+    });
+    auto outer = ps::async(ps::launch::thread_pool, [inner = std::move(inner)]() mutable {
+        return inner.get() * 2;
+    });
+    XCTAssertEqual(outer.get(), 42);
+}
+
+- (void)testReleaseCallables {
+    // the futures outlive the callables, their captures are freed as soon as they ran
+    for (auto policy : {ps::launch::async, ps::launch::deferred, ps::launch::queued, ps::launch::thread_pool})
+    {
+        auto fut = ps::async(policy, [buffer = tracked_buffer()]() {
+            return static_cast<int>(buffer.data.size());
+        }).share();
+        XCTAssertEqual(fut.get(), 1 << 20);
+        XCTAssertEqual(tracked_buffer::alive, 0);
+    }
+    
+    manual_executor executor;
+    auto fut = ps::async(executor, [buffer = tracked_buffer()]() {
+        return static_cast<int>(buffer.data.size());
+    }).share();
+    XCTAssertEqual(tracked_buffer::alive, 1);
+    executor.run();
+    XCTAssertEqual(fut.get(), 1 << 20);
+    XCTAssertEqual(tracked_buffer::alive, 0);
+    
+    ps::promise<int> p;
+    auto chained = p.get_future().then([buffer = tracked_buffer()](ps::future<int> f) {
+        return f.get() + static_cast<int>(buffer.data.size());
+    }).then_error([buffer = tracked_buffer()](std::exception_ptr) {
+        return 0;
+    }).share();
+    XCTAssertEqual(tracked_buffer::alive, 2);
+    p.set_value(1);
+    XCTAssertEqual(chained.get(), (1 << 20) + 1);
+    XCTAssertEqual(tracked_buffer::alive, 0);
+    
+    // a continuation skipped because its parent failed is freed too
+    ps::promise<int> failed;
+    auto skipped = failed.get_future().then([buffer = tracked_buffer()](ps::future<int> f) {
+        return f.get();
+    }).share();
+    XCTAssertEqual(tracked_buffer::alive, 1);
+    failed.set_exception(std::make_exception_ptr(std::logic_error("logic_error")));
+    XCTAssertThrows(skipped.get());
+    XCTAssertEqual(tracked_buffer::alive, 0);
+    
+    // and so is a task that expired on its deadline before it ran
+    auto expired = ps::async(ps::deadline(std::chrono::milliseconds(-1)), ps::launch::thread_pool, [buffer = tracked_buffer()]() {
+        return static_cast<int>(buffer.data.size());
+    }).share();
+    XCTAssertEqual(error_code_of(expired), static_cast<int>(ps::future_errc::timeout));
+    XCTAssertEqual(tracked_buffer::alive, 0);
+    
+    // a callable returning a reference into its captures keeps them as long as the state
+    for (auto policy : {ps::launch::async, ps::launch::deferred, ps::launch::queued, ps::launch::thread_pool})
+    {
+        {
+            auto fut = ps::async(policy, [buffer = tracked_buffer()]() mutable -> tracked_buffer& {
+                return buffer;
+            }).share();
+            XCTAssertEqual(fut.get().data.size(), static_cast<std::size_t>(1 << 20));
+            XCTAssertEqual(tracked_buffer::alive, 1);
+        }
+        XCTAssertEqual(tracked_buffer::alive, 0);
+    }
+}
+
+- (void)testDeferredLazy {
+    using namespace std::chrono_literals;
+    
+    std::atomic<int> runs {0};
+    ps::thread_id tid;
+    auto fut1 = ps::async(ps::launch::deferred, [&runs, &tid]() {
+        tid = ps::this_thread::get_id();
+        return ++runs;
+    });
+    XCTAssertFalse(fut1.is_ready());
+    XCTAssertEqual(fut1.wait_for(1ms), ps::future_status::deferred);
+    XCTAssertEqual(runs, 0);
+    XCTAssertEqual(fut1.get(), 1);
+    XCTAssertEqual(tid, ps::this_thread::get_id());
+    
+    {
+        // an abandoned deferred future never runs, only its state is freed
+        auto fut2 = ps::async(ps::launch::deferred, [&runs, buffer = tracked_buffer()]() {
+            ++runs;
+        });
+        XCTAssertEqual(tracked_buffer::alive, 1);
+    }
+    XCTAssertEqual(tracked_buffer::alive, 0);
+    XCTAssertEqual(runs, 1);
+    
+    auto fut3 = ps::async(ps::launch::deferred, [&runs]() {
+        return ++runs;
+    }).share();
+    fut3.wait();
+    XCTAssertEqual(fut3.wait_for(0ms), ps::future_status::ready);
+    XCTAssertEqual(fut3.get(), 2);
+    XCTAssertEqual(fut3.get(), 2);
+    
+    // attaching a continuation runs the task on the attaching thread
+    auto fut4 = ps::async(ps::launch::deferred, [&runs]() {
+        return ++runs;
+    }).then([](ps::future<int> f) {
+        return f.get() * 10;
+    });
+    XCTAssertEqual(runs, 3);
+    XCTAssertEqual(fut4.get(), 30);
+    
+    auto fut5 = ps::async(ps::launch::deferred, []() -> int {
+        throw std::logic_error("logic_error");
+    });
+    XCTAssertEqual(runs, 3);
+    XCTAssertThrows(fut5.get());
+}
+
+- (void)testBlockingRegion {
+    using namespace std::chrono_literals;
+    
+    ps::async_thread_pool pool(1);
+    pool_blocker blocker;
+    ps::promise<std::size_t> entered;
+    auto size_in_region = entered.get_future();
+    auto blocked = ps::async(pool, [&]() {
+        ps::blocking_region region;
+        ps::blocking_region nested;
+        entered.set_value(pool.size());
+        blocker.wait();
+    });
+    XCTAssertEqual(size_in_region.get(), static_cast<std::size_t>(2));
+    // the only worker is blocked, the replacement runs this one
+    auto other = ps::async(pool, []() {
+        return 42;
+    });
+    XCTAssertEqual(other.wait_for(1s), ps::future_status::ready);
+    XCTAssertEqual(other.get(), 42);
+    blocker.release();
+    blocked.get();
+    for (int i = 0; i < 1000 && pool.size() > 1; ++i)
+    {
+        ps::this_thread::sleep_for(1ms);
+    }
+    XCTAssertEqual(pool.size(), static_cast<std::size_t>(1));
+    
+    XCTAssertEqual(ps::this_task::blocking([]() {
+        return 7;
+    }), 7);
+    XCTAssertEqual(ps::async(pool, []() {
+        return ps::this_task::blocking([]() {
+            return 8;
+        });
+    }).get(), 8);
+}
+
+- (void)testThreadPoolHelpWhileWaiting {
+    // a single worker only gets through the recursion by running the nested tasks from its own waits
+    ps::async_thread_pool pool(1);
+    std::function<int(int)> fib = [&pool, &fib](int n) {
+        if (n < 2)
+        {
+            return n;
+        }
+        auto a = ps::async(pool, fib, n - 1);
+        auto b = ps::async(pool, fib, n - 2);
+        return a.get() + b.get();
+    };
+    XCTAssertEqual(ps::async(pool, fib, 10).get(), 55);
+    
+    ps::promise<int> p;
+    auto waiter = ps::async(pool, [f = p.get_future().share()]() {
+        return f.get();
+    });
+    auto other = ps::async(pool, []() {
+        return 1;
+    });
+    XCTAssertEqual(other.get(), 1);
+    
+    // once the waiting worker backed off, a new task still wakes it up straight away
+    ps::this_thread::sleep_for(std::chrono::milliseconds(200));
+    auto late = ps::async(pool, []() {
+        return 2;
+    });
+    XCTAssertEqual(late.wait_for(std::chrono::milliseconds(32)), ps::future_status::ready);
+    XCTAssertEqual(late.get(), 2);
+    p.set_value(42);
+    XCTAssertEqual(waiter.get(), 42);
+}
+
+- (void)testStrand {
+    constexpr int count = 1000;
+    ps::async_thread_pool pool(4);
+    std::atomic<int> running {0};
+    std::atomic<int> overlap {0};
+    std::vector<int> order;
+    std::vector<int> other_order;
+    std::vector<ps::future<void>> futs;
+    {
+        ps::strand s(pool);
+        ps::strand other(pool);
+        for (int i = 0; i < count; ++i)
+        {
+            futs.push_back(ps::async(s, [&running, &overlap, &order, i]() {
+                if (running++ != 0)
+                {
+                    ++overlap;
+                }
+                order.push_back(i);
+                --running;
+            }));
+            ps::async(other, [&other_order, i]() {
+                other_order.push_back(i);
+            });
+        }
+        ps::when_all(futs.begin(), futs.end()).get();
+        XCTAssertEqual(overlap, 0);
+        XCTAssertEqual(order.size(), static_cast<std::size_t>(count));
+        XCTAssertTrue(std::is_sorted(order.begin(), order.end()));
+        
+        auto fut = ps::async(ps::launch::thread_pool, []() {
+            return 21;
+        }).then(s, [&order](ps::future<int> f) {
+            int v = f.get();
+            order.push_back(v);
+            return v * 2;
+        });
+        XCTAssertEqual(fut.get(), 42);
+        XCTAssertEqual(order.back(), 21);
+    }
+    // the strand destructor waits for its tasks
+    XCTAssertEqual(other_order.size(), static_cast<std::size_t>(count));
+    XCTAssertTrue(std::is_sorted(other_order.begin(), other_order.end()));
+    XCTAssertTrue(ps::is_executor<ps::strand>::value);
+}
+
+- (void)testAsyncBulk {
+    std::vector<int> values(10000);
+    std::iota(values.begin(), values.end(), 0);
+    auto futures = ps::async_bulk(ps::launch::thread_pool, values.begin(), values.end(), [](int v) {
+        return v * 2;
+    });
+    XCTAssertEqual(futures.size(), values.size());
+    bool ordered = true;
+    for (std::size_t i = 0; i < futures.size(); ++i)
+    {
+        ordered = ordered && futures[i].get() == static_cast<int>(i) * 2;
+    }
+    XCTAssertTrue(ordered);
+    
+    ps::async_thread_pool pool(2);
+    std::list<std::string> names {"a", "b", "c"};
+    auto futures2 = ps::async_bulk(pool, names.begin(), names.end(), [](const std::string& name) {
+        return name + name;
+    });
+    XCTAssertEqual(futures2[2].get(), std::string("cc"));
+    
+    manual_executor ex;
+    auto futures3 = ps::async_bulk(ex, values.begin(), values.begin() + 3, [](int) {
+        throw std::logic_error("logic_error");
+    });
+    XCTAssertEqual(ex.run(), static_cast<std::size_t>(3));
+    XCTAssertThrows(futures3[0].get());
+    
+    auto futures4 = ps::async_bulk(ps::launch::async, names.begin(), names.end(), [](std::string name) {
+        return name.size();
+    });
+    XCTAssertEqual(futures4[0].get(), static_cast<std::size_t>(1));
+    
+    // a batch goes to the lane of its priority and overtakes the normal task queued before it
+    ps::async_thread_pool lanes(1, "bulk");
+    std::vector<int> order;
+    pool_blocker blocker;
+    blocker.hold(lanes);
+    auto normal = ps::async(lanes, [&order]() {
+        order.push_back(-1);
+    });
+    auto critical = ps::async_bulk(ps::priority::critical, lanes, values.begin(), values.begin() + 3, [&order](int v) {
+        order.push_back(v);
+    });
+    blocker.release();
+    ps::when_all(critical.begin(), critical.end()).get();
+    normal.get();
+    XCTAssertTrue(order == std::vector<int>({0, 1, 2, -1}));
+}
+
 - (void)testWhenAllT {
     using namespace std::chrono_literals;
     
@@ -2198,6 +3488,47 @@
     XCTAssertEqual(ret5[2], 3);
 }
 
+- (void)testMakeReadyInline {
+    using namespace std::chrono_literals;
+    
+    auto fut1 = ps::make_ready_future(std::string("42"));
+    XCTAssertTrue(fut1.valid());
+    XCTAssertEqual(fut1.wait_for(0ms), ps::future_status::ready);
+    fut1.wait();
+    XCTAssertEqual(fut1.get(), std::string("42"));
+    XCTAssertFalse(fut1.valid());
+    
+    auto fut2 = ps::make_ready_future(21).then([](ps::future<int> f) {
+        return f.get() * 2;
+    }).then([](ps::future<int> f) {
+        return ps::make_ready_future(f.get() + 1);
+    });
+    XCTAssertTrue(fut2.is_ready());
+    XCTAssertEqual(fut2.get(), 43);
+    
+    auto fut3 = ps::make_ready_future().then([](ps::future<void> f) {
+        f.get();
+        throw std::logic_error("logic_error");
+    });
+    XCTAssertTrue(fut3.is_ready());
+    XCTAssertThrows(fut3.get());
+    
+    auto fut4 = ps::make_ready_future(42);
+    ps::future<int> fut5;
+    fut5.swap(fut4);
+    XCTAssertFalse(fut4.valid());
+    auto shared5 = fut5.share();
+    XCTAssertFalse(fut5.valid());
+    XCTAssertTrue(shared5.is_ready());
+    XCTAssertEqual(shared5.get(), 42);
+    XCTAssertEqual(shared5.get(), 42);
+    
+    auto fut6 = ps::async(ps::launch::async, []() {
+        return ps::make_ready_future(42);
+    });
+    XCTAssertEqual(fut6.get(), 42);
+}
+
 - (void)testMakeExceptionalFuture {
     std::exception_ptr e = nullptr;
     auto fut1 = ps::make_exceptional_future<int>(std::make_exception_ptr(std::logic_error("logic_error1")));
@@ -2220,4 +3551,87 @@
     XCTAssertNotEqual(e, nullptr);
 }
 
+- (void)testWaitPolicy {
+    using namespace std::chrono_literals;
+    
+    const auto previous = ps::get_wait_policy();
+    
+    ps::wait_policy park;
+    park.max_spin = 0;
+    park.max_yield = 0;
+    park.adaptive = false;
+    ps::set_wait_policy(park);
+    XCTAssertEqual(ps::get_wait_policy().max_spin, 0u);
+    XCTAssertEqual(ps::get_wait_policy().max_yield, 0u);
+    XCTAssertFalse(ps::get_wait_policy().adaptive);
+    auto fut1 = ps::async(ps::launch::thread_pool, []() {
+        ps::this_thread::sleep_for(1ms);
+        return 42;
+    });
+    XCTAssertEqual(fut1.get(), 42);
+    
+    ps::wait_policy spin;
+    spin.max_spin = 1 << 16;
+    spin.max_yield = 16;
+    spin.adaptive = true;
+    ps::set_wait_policy(spin);
+    for (int i = 0; i < 100; ++i)
+    {
+        auto fut2 = ps::async(ps::launch::thread_pool, [i]() {
+            return i;
+        }).share();
+        fut2.wait();
+        XCTAssertEqual(fut2.get(), i);
+    }
+    
+    // without spins nor yields the waiter parks straight away
+    ps::set_wait_policy(park);
+    observed_state parked;
+    auto t1 = ps::thread([&parked]() {
+        parked.wait();
+    });
+    for (int i = 0; i < 1000 && !parked.parked(); ++i)
+    {
+        ps::this_thread::sleep_for(1ms);
+    }
+    XCTAssertTrue(parked.parked());
+    parked.set_value();
+    t1.join();
+    
+    // a yield count larger than the wait keeps the waiter off the futex
+    ps::wait_policy yield;
+    yield.max_spin = 0;
+    yield.max_yield = std::numeric_limits<std::uint32_t>::max();
+    yield.adaptive = false;
+    ps::set_wait_policy(yield);
+    observed_state yielding;
+    auto t2 = ps::thread([&yielding]() {
+        yielding.wait();
+    });
+    ps::this_thread::sleep_for(5ms);
+    XCTAssertFalse(yielding.parked());
+    yielding.set_value();
+    t2.join();
+    
+    // same with spins, which are skipped on a single core
+    if (ps::thread::hardware_concurrency() > 1)
+    {
+        ps::wait_policy busy;
+        busy.max_spin = std::numeric_limits<std::uint32_t>::max();
+        busy.max_yield = 0;
+        busy.adaptive = false;
+        ps::set_wait_policy(busy);
+        observed_state spinning;
+        auto t3 = ps::thread([&spinning]() {
+            spinning.wait();
+        });
+        ps::this_thread::sleep_for(5ms);
+        XCTAssertFalse(spinning.parked());
+        spinning.set_value();
+        t3.join();
+    }
+    
+    ps::set_wait_policy(previous);
+}
+
 @end